@@ -0,0 +1,108 @@
+#include "AdminServer.hpp"
+#include "Stats.hpp"
+#include "Logger.hpp"
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <system_error>
+
+namespace {
+
+const size_t MAX_REQUEST = 8192;  // Headers beyond this are not read
+
+void writeAll(int fd, const std::string& text) {
+    const char* data = text.data();
+    size_t left = text.size();
+    while (left > 0) {
+        ssize_t sent = send(fd, data, left, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return;
+        }
+        data += sent;
+        left -= (size_t)sent;
+    }
+}
+
+} // namespace
+
+AdminServer::AdminServer(uint16_t port) {
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd == -1) {
+        throw std::system_error(errno, std::generic_category(), "admin socket");
+    }
+    int yes = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof yes);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof address) == -1 || listen(listenFd, 16) == -1) {
+        int error = errno;
+        close(listenFd);
+        throw std::system_error(error, std::generic_category(), "admin bind");
+    }
+    thread = std::thread(&AdminServer::run, this);
+}
+
+AdminServer::~AdminServer() {
+    stopping.store(true);
+    shutdown(listenFd, SHUT_RDWR);  // Wakes the accept
+    thread.join();
+    close(listenFd);
+}
+
+void AdminServer::run() {
+    while (!stopping.load()) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno != EINTR && !stopping.load()) {
+                LOG(WARN) << "admin accept: " << std::strerror(errno);
+            }
+            continue;
+        }
+        serve(fd);
+        close(fd);
+    }
+}
+
+// Reads the request line and headers (a scraper that stalls is dropped after a second), replies, closes
+void AdminServer::serve(int fd) {
+    timeval timeout{1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.find("\n\n") == std::string::npos &&
+           request.size() < MAX_REQUEST) {
+        ssize_t received = recv(fd, buffer, sizeof buffer, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            break;
+        }
+        request.append(buffer, (size_t)received);
+    }
+
+    std::string body;
+    std::string status = "200 OK";
+    const char* type = "text/plain; version=0.0.4; charset=utf-8";
+    if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 14, "GET /metrics\r\n") == 0) {
+        Stats::writePrometheus(body);
+    } else {
+        status = "404 Not Found";
+        type = "text/plain; charset=utf-8";
+        body = "Only GET /metrics is served here\n";
+    }
+    std::string reply = "HTTP/1.0 " + status + "\r\nContent-Type: " + type + "\r\nContent-Length: " +
+                        std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+    writeAll(fd, reply);
+    writeAll(fd, body);
+}
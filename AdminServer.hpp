@@ -0,0 +1,29 @@
+#ifndef ADMINSERVER_HPP
+#define ADMINSERVER_HPP
+
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+/* Local admin endpoint for monitoring.
+A single thread on 127.0.0.1:port answers "GET /metrics" with Stats in the Prometheus
+text format (HTTP/1.0, one request per connection) and anything else with 404. It is
+kept apart from the client port so scraping never competes with clients for the front
+end's queues, and it only listens on loopback.
+*/
+class AdminServer {
+public:
+    // Throws std::system_error if the port cannot be bound
+    explicit AdminServer(uint16_t port);
+    ~AdminServer();
+
+private:
+    void run();
+    void serve(int fd);
+
+    int listenFd;
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+};
+
+#endif // ADMINSERVER_HPP
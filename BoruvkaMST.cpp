@@ -1,4 +1,5 @@
 #include "BoruvkaMST.hpp"
+#include "Trace.hpp"
 #include <algorithm>
 #include <queue>
 
@@ -18,6 +19,7 @@ struct CompareWeight {
 };
 
 Tree BoruvkaMST::computeMST(const Graph& graph) {
+    TRACE_SPAN("boruvka");
     size_t V = static_cast<size_t>(graph.getVertices());
     Tree mst(V); // Initialize an empty Tree for MST
     std::vector<int> cheapest(V, -1); // To store cheapest edge to each component
@@ -26,32 +28,40 @@ Tree BoruvkaMST::computeMST(const Graph& graph) {
     std::priority_queue<Edge, std::vector<Edge>, CompareWeight> pq;
 
     // Initialize each vertex as its own component
-    for (size_t v = 0; v < V; ++v) {
-        component[v] = v;
-        for (const auto& neighbor : graph.getAdjList(v)) {
-            pq.push(Edge(v, neighbor.first, neighbor.second));
+    {
+        TRACE_SPAN("boruvka.queue_edges");
+        for (size_t v = 0; v < V; ++v) {
+            component[v] = v;
+            for (const auto& neighbor : graph.getAdjList(v)) {
+                pq.push(Edge(v, neighbor.first, neighbor.second));
+            }
         }
     }
 
-    while (mst.getEdgesCount() < static_cast<int>(V) - 1 && !pq.empty()) {
-        Edge e = pq.top();
-        pq.pop();
+    {
+        TRACE_SPAN("boruvka.merge");  // Heap pops, union-find and Tree::addEdge
+        while (mst.getEdgesCount() < static_cast<int>(V) - 1 && !pq.empty()) {
+            Edge e = pq.top();
+            pq.pop();
 
-        int u = e.src;
-        int v = e.dest;
-        double weight = e.weight;
+            int u = e.src;
+            int v = e.dest;
+            double weight = e.weight;
 
-        // Find components of u and v
-        int comp_u = find(component, u);
-        int comp_v = find(component, v);
+            // Find components of u and v
+            int comp_u = find(component, u);
+            int comp_v = find(component, v);
 
-        // If they belong to different components, add edge to MST
-        if (comp_u != comp_v) {
-            mst.addEdge((size_t)u, (size_t)v, weight);
-            Union(component, cheapest, u, v, comp_u, comp_v); // Adjust Union call
+            // If they belong to different components, add edge to MST
+            if (comp_u != comp_v) {
+                mst.addEdge((size_t)u, (size_t)v, weight);
+                Union(component, cheapest, u, v, comp_u, comp_v); // Adjust Union call
+            }
         }
     }
 
+    mst.finalize();  // Pack into the CSR layout before the tree is shared
+
     return mst;
 }
 
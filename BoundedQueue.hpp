@@ -0,0 +1,175 @@
+#ifndef BOUNDEDQUEUE_HPP
+#define BOUNDEDQUEUE_HPP
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstddef>
+#include <cstdint>
+
+/* Bounded multi-producer, single-consumer ring buffer.
+Each cell carries a sequence number (Vyukov's scheme): a producer claims a slot with one
+CAS on the tail and publishes it with a release store of the cell sequence, and the
+consumer takes cells in order without any read-modify-write. A single producer is just
+the uncontended case, so the same queue serves SPSC links.
+Waiting is adaptive on both sides: a full ring (producer) or an empty one (consumer) is
+first polled with a CPU pause, then with yields, and only then does the thread park on a
+condition variable. The other side takes the mutex only if it sees someone parked, so a
+busy pipeline hands messages over without system calls.
+*/
+template <typename T>
+class BoundedQueue {
+public:
+    // Capacity is rounded up to a power of two
+    explicit BoundedQueue(size_t capacity) : cells(roundUp(capacity)), mask(cells.size() - 1) {
+        for (size_t i = 0; i < cells.size(); ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // Moves value in and returns true, or leaves it alone if the ring is full
+    bool tryPush(T& value) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[pos & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    wake(consumerParked, notEmpty);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // The consumer has not freed this cell yet
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Blocks while the ring is full
+    void push(T value) {
+        while (!tryPush(value)) {
+            await([this]() { return !full(); }, producersParked, notFull);
+        }
+    }
+
+    // Consumer only: appends up to max ready items to out
+    size_t tryPopBatch(std::vector<T>& out, size_t max) {
+        size_t count = 0;
+        while (count < max) {
+            Cell& cell = cells[head & mask];
+            if (cell.sequence.load(std::memory_order_acquire) != head + 1) {
+                break;
+            }
+            out.push_back(std::move(cell.value));
+            cell.value = T();
+            cell.sequence.store(head + mask + 1, std::memory_order_release);
+            ++head;
+            ++count;
+        }
+        if (count > 0) {
+            wake(producersParked, notFull);
+        }
+        return count;
+    }
+
+    // Consumer only: blocks until something is ready; returns 0 once closed and drained
+    size_t popBatch(std::vector<T>& out, size_t max) {
+        while (true) {
+            size_t count = tryPopBatch(out, max);
+            if (count > 0) {
+                return count;
+            }
+            if (closed.load(std::memory_order_acquire)) {
+                return tryPopBatch(out, max);  // Items pushed right before close()
+            }
+            await([this]() { return !empty() || closed.load(std::memory_order_acquire); }, consumerParked, notEmpty);
+        }
+    }
+
+    // Wakes the consumer for good; nothing may be pushed afterwards
+    void close() {
+        closed.store(true, std::memory_order_release);
+        wake(consumerParked, notEmpty);
+    }
+
+private:
+    static constexpr int SPIN_ROUNDS = 256;
+    static constexpr int YIELD_ROUNDS = 16;
+
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    static size_t roundUp(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    static void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+    bool empty() const {
+        return cells[head & mask].sequence.load(std::memory_order_acquire) != head + 1;
+    }
+
+    bool full() const {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        return cells[pos & mask].sequence.load(std::memory_order_acquire) < pos;
+    }
+
+    // Spin, then yield, then park until ready() holds
+    template <typename Ready>
+    void await(Ready ready, std::atomic<size_t>& parked, std::condition_variable& condition) {
+        for (int i = 0; i < SPIN_ROUNDS; ++i) {
+            if (ready()) return;
+            cpuRelax();
+        }
+        for (int i = 0; i < YIELD_ROUNDS; ++i) {
+            if (ready()) return;
+            std::this_thread::yield();
+        }
+        std::unique_lock<std::mutex> lock(parkMutex);
+        parked.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        condition.wait(lock, ready);
+        parked.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Pairs with the fences in await(): either the waiter sees our update or we see it parked
+    void wake(std::atomic<size_t>& parked, std::condition_variable& condition) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked.load(std::memory_order_seq_cst) > 0) {
+            std::lock_guard<std::mutex> lock(parkMutex);
+            condition.notify_all();
+        }
+    }
+
+    std::vector<Cell> cells;
+    const size_t mask;
+    alignas(64) std::atomic<size_t> tail{0};     // Next cell to claim (producers)
+    alignas(64) size_t head = 0;                 // Next cell to take (consumer)
+    alignas(64) std::atomic<bool> closed{false};
+    std::atomic<size_t> consumerParked{0};
+    std::atomic<size_t> producersParked{0};
+    std::mutex parkMutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+};
+
+#endif // BOUNDEDQUEUE_HPP
@@ -0,0 +1,98 @@
+#include "Clustering.hpp"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+// Union-find with path halving and union by size
+struct DisjointSets {
+    std::vector<uint32_t> parent;
+    std::vector<uint32_t> size;
+
+    explicit DisjointSets(size_t n) : parent(n), size(n, 1) {
+        std::iota(parent.begin(), parent.end(), 0);
+    }
+
+    uint32_t find(uint32_t x) {
+        while (parent[x] != x) {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    }
+
+    void unite(uint32_t a, uint32_t b) {
+        a = find(a);
+        b = find(b);
+        if (a == b) {
+            return;
+        }
+        if (size[a] < size[b]) {
+            std::swap(a, b);
+        }
+        parent[b] = a;
+        size[a] += size[b];
+    }
+};
+
+// Turns the current union-find state into dense labels and cluster sizes
+Clustering snapshot(DisjointSets& sets, size_t vertices) {
+    Clustering result;
+    result.labels.assign(vertices, 0);
+    std::vector<uint32_t> labelOfRoot(vertices, UINT32_MAX);
+    for (size_t v = 0; v < vertices; ++v) {
+        uint32_t root = sets.find(static_cast<uint32_t>(v));
+        if (labelOfRoot[root] == UINT32_MAX) {
+            labelOfRoot[root] = static_cast<uint32_t>(result.sizes.size());
+            result.sizes.push_back(0);
+        }
+        result.labels[v] = labelOfRoot[root];
+        ++result.sizes[labelOfRoot[root]];
+    }
+    result.k = result.sizes.size();
+    return result;
+}
+
+} // namespace
+
+SingleLinkage::SingleLinkage(const Tree& mst) : vertices(mst.getVertices()) {
+    mergeOrder.reserve(static_cast<size_t>(mst.getEdgesCount()));
+    mst.forEachEdge([this](const TreeEdge& edge) {
+        mergeOrder.push_back(edge);
+    });
+    std::stable_sort(mergeOrder.begin(), mergeOrder.end(), [](const TreeEdge& a, const TreeEdge& b) {
+        return a.weight < b.weight;
+    });
+}
+
+Clustering SingleLinkage::cluster(size_t k) const {
+    return cluster(std::vector<size_t>{k}).front();
+}
+
+std::vector<Clustering> SingleLinkage::cluster(const std::vector<size_t>& ks) const {
+    for (size_t k : ks) {
+        if (k == 0 || k > vertices) {
+            throw std::out_of_range("SingleLinkage: k must be between 1 and the number of vertices");
+        }
+    }
+
+    // Largest k first: each one needs a longer prefix of the merge order than the last
+    std::vector<size_t> byMerges(ks.size());
+    std::iota(byMerges.begin(), byMerges.end(), 0);
+    std::sort(byMerges.begin(), byMerges.end(), [&ks](size_t a, size_t b) {
+        return ks[a] > ks[b];
+    });
+
+    std::vector<Clustering> results(ks.size());
+    DisjointSets sets(vertices);
+    size_t applied = 0;
+    for (size_t index : byMerges) {
+        size_t merges = std::min(vertices - ks[index], mergeOrder.size());
+        for (; applied < merges; ++applied) {
+            sets.unite(mergeOrder[applied].u, mergeOrder[applied].v);
+        }
+        results[index] = snapshot(sets, vertices);
+    }
+    return results;
+}
@@ -0,0 +1,36 @@
+#ifndef CLUSTERING_HPP
+#define CLUSTERING_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "Tree.hpp"
+
+// Cluster assignment for one value of k
+struct Clustering {
+    size_t k;                      // Number of clusters actually produced
+    std::vector<uint32_t> labels;  // labels[v] in [0, k), numbered by first vertex
+    std::vector<size_t> sizes;     // sizes[label]
+};
+
+/* Single-linkage clustering read straight off an MST.
+Cutting the k-1 heaviest MST edges is the same as applying only the V-k lightest ones,
+so the edges are sorted once (the dendrogram merge order) and every k is answered by
+replaying a prefix of that order into a union-find. Several k values share one replay.
+A forest with c components cannot be split into fewer than c clusters; smaller k values
+are raised to c.
+*/
+class SingleLinkage {
+public:
+    explicit SingleLinkage(const Tree& mst);
+
+    Clustering cluster(size_t k) const;
+    // Results are returned in the order of ks
+    std::vector<Clustering> cluster(const std::vector<size_t>& ks) const;
+
+private:
+    size_t vertices;
+    std::vector<TreeEdge> mergeOrder;  // MST edges by increasing weight
+};
+
+#endif // CLUSTERING_HPP
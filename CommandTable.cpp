@@ -0,0 +1,97 @@
+#include "CommandTable.hpp"
+#include <stdexcept>
+
+namespace {
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// FNV-1a with the seed folded into the offset basis
+uint64_t hashName(std::string_view name, uint64_t seed) {
+    uint64_t hash = 0xcbf29ce484222325ULL ^ (seed * 0x9e3779b97f4a7c15ULL);
+    for (char c : name) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash ^ (hash >> 29);
+}
+
+} // namespace
+
+bool CommandArgs::next(std::string_view& token) {
+    size_t start = 0;
+    while (start < rest_.size() && isSpace(rest_[start])) {
+        ++start;
+    }
+    size_t end = start;
+    while (end < rest_.size() && !isSpace(rest_[end])) {
+        ++end;
+    }
+    token = rest_.substr(start, end - start);
+    rest_.remove_prefix(end);
+    return !token.empty();
+}
+
+bool CommandArgs::next(double& value) {
+    std::string_view token;
+    return next(token) && parse(token, value);
+}
+
+bool CommandArgs::empty() {
+    std::string_view probe = rest_;
+    std::string_view token;
+    bool found = next(token);
+    rest_ = probe;
+    return !found;
+}
+
+bool CommandArgs::parse(std::string_view token, double& value) {
+    const char* end = token.data() + token.size();
+    auto result = std::from_chars(token.data(), end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+void PerfectHash::build(const std::vector<std::string>& names) {
+    // Smallest power of two with room to spare, then seeds until no two names share a slot;
+    // the table doubles if a size keeps colliding
+    size_t size = 8;
+    while (size < 2 * names.size()) {
+        size *= 2;
+    }
+    while (true) {
+        for (uint64_t seed = 0; seed < 256; ++seed) {
+            seed_ = seed;
+            mask_ = size - 1;
+            slots_.assign(size, -1);
+            bool collision = false;
+            for (size_t i = 0; i < names.size() && !collision; ++i) {
+                int& entry = slots_[slot(names[i])];
+                collision = entry != -1;
+                entry = static_cast<int>(i);
+            }
+            if (!collision) {
+                return;
+            }
+        }
+        size *= 2;
+        if (size > (1u << 20)) {
+            throw std::logic_error("PerfectHash: duplicate names");
+        }
+    }
+}
+
+int PerfectHash::find(std::string_view name, const std::vector<std::string>& names) const {
+    if (slots_.empty()) {
+        return -1;
+    }
+    int index = slots_[slot(name)];
+    if (index < 0 || names[static_cast<size_t>(index)] != name) {
+        return -1;
+    }
+    return index;
+}
+
+size_t PerfectHash::slot(std::string_view name) const {
+    return static_cast<size_t>(hashName(name, seed_)) & mask_;
+}
@@ -0,0 +1,108 @@
+#ifndef COMMANDTABLE_HPP
+#define COMMANDTABLE_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <charconv>
+#include <type_traits>
+#include <cstdint>
+#include <cstddef>
+#include "Stats.hpp"
+
+// The whitespace-separated arguments of one text command, parsed in place with std::from_chars
+class CommandArgs {
+public:
+    explicit CommandArgs(std::string_view line) : rest_(line) {}
+
+    // Next raw token; false when there are none left
+    bool next(std::string_view& token);
+
+    // Next token as a number; false (and value untouched) if it is missing or not entirely a number
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+    bool next(T& value) {
+        std::string_view token;
+        return next(token) && parse(token, value);
+    }
+    bool next(double& value);
+
+    bool empty();  // No tokens left
+
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+    static bool parse(std::string_view token, T& value) {
+        const char* end = token.data() + token.size();
+        auto result = std::from_chars(token.data(), end, value);
+        return result.ec == std::errc() && result.ptr == end;
+    }
+    static bool parse(std::string_view token, double& value);
+
+private:
+    std::string_view rest_;
+};
+
+// Collision-free slot table over a fixed set of names: a lookup is one hash and one comparison
+class PerfectHash {
+public:
+    void build(const std::vector<std::string>& names);
+    // Index of name in the list given to build(), or -1
+    int find(std::string_view name, const std::vector<std::string>& names) const;
+
+private:
+    size_t slot(std::string_view name) const;
+
+    uint64_t seed_ = 0;
+    size_t mask_ = 0;
+    std::vector<int> slots_;
+};
+
+/* Text command dispatch shared by both servers.
+Handlers are registered by name (the first token of a line) and receive the session
+(Context), the remaining arguments and the reply buffer. The names are indexed by a
+perfect hash, so finding a handler costs the same for every command, and adding a command
+is one add() call. Tables are filled once at startup and only read afterwards.
+Every command's run time (parse, work and formatting of the reply) is recorded in the
+command_seconds histogram under its name.
+*/
+template <typename Context>
+class CommandTable {
+public:
+    using Handler = std::function<void(Context& context, CommandArgs& args, std::string& out)>;
+
+    // Registers name, replacing an earlier handler of the same name
+    void add(std::string_view name, Handler handler) {
+        int index = index_.find(name, names_);
+        if (index >= 0) {
+            handlers_[static_cast<size_t>(index)] = std::move(handler);
+            return;
+        }
+        names_.emplace_back(name);
+        handlers_.push_back(std::move(handler));
+        timings_.push_back(Stats::histogram("command_seconds", "command=\"" + names_.back() + "\""));
+        index_.build(names_);
+    }
+
+    // Runs the command of line; false if there is no handler for it
+    bool dispatch(Context& context, std::string_view line, std::string& out) const {
+        CommandArgs args(line);
+        std::string_view name;
+        if (!args.next(name)) {
+            return false;
+        }
+        int index = index_.find(name, names_);
+        if (index < 0) {
+            return false;
+        }
+        ScopedTimer timer(timings_[static_cast<size_t>(index)]);
+        handlers_[static_cast<size_t>(index)](context, args, out);
+        return true;
+    }
+
+private:
+    std::vector<std::string> names_;
+    std::vector<Handler> handlers_;
+    std::vector<Stats::Id> timings_;
+    PerfectHash index_;
+};
+
+#endif // COMMANDTABLE_HPP
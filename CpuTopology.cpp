@@ -0,0 +1,117 @@
+#include "CpuTopology.hpp"
+#include <pthread.h>
+#include <sched.h>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <algorithm>
+
+std::vector<int> allowedCpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (size_t cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(static_cast<int>(cpu));
+            }
+        }
+    }
+    if (cpus.empty()) {
+        unsigned count = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned cpu = 0; cpu < count; ++cpu) {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+    }
+    return cpus;
+}
+
+namespace {
+
+// CPU quota of the cgroup in whole CPUs (rounded up), or 0 when unlimited/unknown
+size_t cgroupCpuLimit() {
+    double quota = -1, period = -1;
+
+    // cgroup v2: "max 100000" or "<quota> <period>"
+    std::ifstream v2("/sys/fs/cgroup/cpu.max");
+    std::string quotaText;
+    if (v2 >> quotaText >> period) {
+        if (quotaText != "max") {
+            quota = std::stod(quotaText);
+        }
+    } else {
+        // cgroup v1: quota is -1 when unlimited
+        std::ifstream quotaFile("/sys/fs/cgroup/cpu/cpu.cfs_quota_us");
+        std::ifstream periodFile("/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+        if (!(quotaFile >> quota) || !(periodFile >> period)) {
+            return 0;
+        }
+    }
+    if (quota <= 0 || period <= 0) {
+        return 0;
+    }
+    return static_cast<size_t>((quota + period - 1) / period);
+}
+
+// count CPUs taken round-robin from allowed[first, last)
+std::vector<int> cpuRange(const std::vector<int>& allowed, size_t first, size_t last, size_t count) {
+    std::vector<int> cpus;
+    for (size_t i = 0; i < count; ++i) {
+        cpus.push_back(allowed[first + i % (last - first)]);
+    }
+    return cpus;
+}
+
+// Number of leading allowed CPUs reserved for I/O threads; the rest is left to compute
+size_t reservedIoCpus(size_t allowed, size_t ioThreads) {
+    return allowed < 2 ? allowed : std::min(ioThreads, allowed - 1);
+}
+
+} // namespace
+
+size_t availableCpus() {
+    size_t cpus = allowedCpus().size();
+    size_t limit = cgroupCpuLimit();
+    if (limit > 0) {
+        cpus = std::min(cpus, limit);
+    }
+    return std::max<size_t>(1, cpus);
+}
+
+bool pinCurrentThread(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(static_cast<size_t>(cpu), &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+PoolConfig PoolConfig::defaults() {
+    size_t cpus = availableCpus();
+    PoolConfig config;
+    config.computeThreads = cpus;
+    // Connection threads mostly wait on the network, but also run the commands
+    config.ioThreads = std::max<size_t>(2, cpus / 2);
+    return config;
+}
+
+std::vector<int> PoolConfig::computeCpus() const {
+    if (!pin) {
+        return {};
+    }
+    std::vector<int> allowed = allowedCpus();
+    size_t reserved = reservedIoCpus(allowed.size(), ioThreads);
+    size_t first = reserved < allowed.size() ? reserved : 0;
+    return cpuRange(allowed, first, allowed.size(), computeThreads);
+}
+
+std::vector<int> PoolConfig::ioCpus() const {
+    if (!pin) {
+        return {};
+    }
+    std::vector<int> allowed = allowedCpus();
+    return cpuRange(allowed, 0, reservedIoCpus(allowed.size(), ioThreads), ioThreads);
+}
+
+bool PoolConfig::pinnedPoolsOverlap() const {
+    return pin && allowedCpus().size() < 2;
+}
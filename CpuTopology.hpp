@@ -0,0 +1,33 @@
+#ifndef CPUTOPOLOGY_HPP
+#define CPUTOPOLOGY_HPP
+
+#include <vector>
+#include <cstddef>
+
+// CPUs this process may run on (its affinity mask), in increasing order
+std::vector<int> allowedCpus();
+
+// Number of CPUs worth of threads: the affinity mask capped by any cgroup CPU quota
+size_t availableCpus();
+
+// Pins the calling thread to one CPU; returns false if the kernel refused
+bool pinCurrentThread(int cpu);
+
+/* Thread counts for the I/O (connection) pool and the compute (work-stealing) pool.
+Defaults come from availableCpus(); the servers let both be overridden at startup.
+With pinning enabled, I/O threads get the first allowed CPUs (at most ioThreads of them,
+always leaving one) and compute workers the rest, each pool wrapping around within its
+own CPUs; only with a single allowed CPU do the two pools share it.
+*/
+struct PoolConfig {
+    size_t ioThreads;
+    size_t computeThreads;
+    bool pin = false;
+
+    static PoolConfig defaults();
+    std::vector<int> computeCpus() const;  // Empty unless pinning
+    std::vector<int> ioCpus() const;
+    bool pinnedPoolsOverlap() const;       // True if pinning has to put both pools on the same CPUs
+};
+
+#endif // CPUTOPOLOGY_HPP
@@ -1,37 +1,110 @@
 #include "Graph.hpp"
+#include "ReplyWriter.hpp"
 #include <algorithm>
+#include <atomic>
+#include <stdexcept>
 
 using namespace std;
 
+namespace {
+
+// True when this is the only reference. A new one can only come from copying the Graph,
+// which the caller is editing; the fence orders the edit after other copies' last reads
+template <typename T>
+bool exclusive(const shared_ptr<T>& piece) {
+    if (piece.use_count() != 1) {
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return true;
+}
+
+} // namespace
+
 Graph::Graph(int myVertices) : vertices(myVertices) {
-    adjList.resize((size_t)myVertices);
+    size_t leaves = ((size_t)myVertices + LEAF_SIZE - 1) / LEAF_SIZE;
+    branches.resize((leaves + BRANCH_SIZE - 1) / BRANCH_SIZE);
+    for (size_t b = 0; b < branches.size(); b++) {
+        branches[b] = make_shared<Branch>();
+        for (size_t l = 0; l < BRANCH_SIZE && b * BRANCH_SIZE + l < leaves; l++) {
+            branches[b]->leaves[l] = make_shared<Leaf>();
+        }
+    }
+}
+
+Graph::List& Graph::mutableAdjacency(size_t u) {
+    shared_ptr<Branch>& branch = branches[u >> (LEAF_BITS + BRANCH_BITS)];
+    if (!exclusive(branch)) {
+        branch = make_shared<Branch>(*branch);
+    }
+    shared_ptr<Leaf>& leaf = branch->leaves[(u >> LEAF_BITS) & (BRANCH_SIZE - 1)];
+    if (!exclusive(leaf)) {
+        leaf = make_shared<Leaf>(*leaf);
+    }
+    return leaf->lists[u & (LEAF_SIZE - 1)];
 }
 
 void Graph::addEdge(size_t u, size_t v, double weight) {
-    adjList[u].emplace_back(v, weight);
-    adjList[v].emplace_back(u, weight); // Since the graph is undirected
+    mutableAdjacency(u).emplace_back(v, weight);
+    mutableAdjacency(v).emplace_back(u, weight); // Since the graph is undirected
+}
+
+void Graph::addEdges(const vector<WeightedEdge>& edges) {
+    // Validate and count the new neighbours first, so each list grows at most once
+    vector<uint32_t> added((size_t)vertices, 0);
+    for (const WeightedEdge& edge : edges) {
+        if (edge.u >= (uint32_t)vertices || edge.v >= (uint32_t)vertices) {
+            throw std::out_of_range("Graph::addEdges: vertex out of range");
+        }
+        added[edge.u]++;
+        added[edge.v]++;
+    }
+    for (size_t i = 0; i < (size_t)vertices; i++) {
+        if (added[i] > 0) {
+            List& list = mutableAdjacency(i);
+            list.reserve(list.size() + added[i]);
+        }
+    }
+    for (const WeightedEdge& edge : edges) {
+        mutableAdjacency(edge.u).emplace_back(edge.v, edge.weight);
+        mutableAdjacency(edge.v).emplace_back(edge.u, edge.weight);
+    }
 }
 
 void Graph::removeEdge(size_t u, size_t v) {
-    // Remove edge from u to v
-    auto it = std::remove_if(adjList[u].begin(), adjList[u].end(), 
-                             [v](const std::pair<size_t, double>& edge) {
-                                 return edge.first == v;
-                             });
-    if (it != adjList[u].end()) {
-        adjList[u].erase(it, adjList[u].end());
+    // Remove edge from u to v, and from v to u (because the graph is undirected);
+    // lists without the edge are left alone, so copies keep sharing them
+    auto isTo = [](size_t w) {
+        return [w](const std::pair<int, double>& edge) { return (size_t)edge.first == w; };
+    };
+    if (std::any_of(adjacency(u).begin(), adjacency(u).end(), isTo(v))) {
+        List& list = mutableAdjacency(u);
+        list.erase(std::remove_if(list.begin(), list.end(), isTo(v)), list.end());
+    }
+    if (std::any_of(adjacency(v).begin(), adjacency(v).end(), isTo(u))) {
+        List& list = mutableAdjacency(v);
+        list.erase(std::remove_if(list.begin(), list.end(), isTo(u)), list.end());
     }
+}
 
-    // Remove edge from v to u (because the graph is undirected)
-    it = std::remove_if(adjList[v].begin(), adjList[v].end(), 
-                        [u](const std::pair<size_t, double>& edge) {
-                            return edge.first == u;
-                        });
-    if (it != adjList[v].end()) {
-        adjList[v].erase(it, adjList[v].end());
+void Graph::removeEdges(const vector<pair<uint32_t, uint32_t>>& pairs) {
+    for (const auto& pair : pairs) {
+        if (pair.first >= (uint32_t)vertices || pair.second >= (uint32_t)vertices) {
+            throw std::out_of_range("Graph::removeEdges: vertex out of range");
+        }
+    }
+    for (const auto& pair : pairs) {
+        removeEdge(pair.first, pair.second);
     }
 }
 
+void Graph::assignAdjacency(size_t u, const uint32_t* neighbors, const double* weights, size_t count) {
+    List& list = mutableAdjacency(u);
+    list.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        list[i] = {(int)neighbors[i], weights[i]};
+    }
+}
 
 bool Graph::isConnected() {
     vector<bool> visited((size_t)vertices, false);
@@ -39,7 +112,7 @@ bool Graph::isConnected() {
 
     // Find a vertex with a non-zero degree
     for (i = 0; i < (size_t)vertices; i++) {
-        if (!adjList[i].empty()) {
+        if (!adjacency(i).empty()) {
             break;
         }
     }
@@ -54,7 +127,7 @@ bool Graph::isConnected() {
 
     // Check if all vertices with non-zero degree are visited
     for (i = 0; i < (size_t)vertices; i++) {
-        if (!adjList[i].empty() && !visited[i]) {
+        if (!adjacency(i).empty() && !visited[i]) {
             return false;
         }
     }
@@ -65,7 +138,7 @@ bool Graph::isConnected() {
 void Graph::DFS(size_t v, vector<bool>& visited) {
     visited[v] = true;
 
-    for (auto& neighbor : adjList[v]) {
+    for (auto& neighbor : adjacency(v)) {
         if (!visited[(size_t)neighbor.first]) {
             DFS((size_t)neighbor.first, visited);
         }
@@ -74,7 +147,7 @@ void Graph::DFS(size_t v, vector<bool>& visited) {
 
 int Graph::findStartVertex() {
     for (size_t i = 0; i < (size_t)vertices; i++) {
-        if (adjList[i].size() % 2 != 0) {
+        if (adjacency(i).size() % 2 != 0) {
             return i;
         }
     }
@@ -88,7 +161,7 @@ bool Graph::isEulerian() {
 
     int odd = 0;
     for (size_t i = 0; i < (size_t)vertices; i++) {
-        if (adjList[i].size() % 2 != 0) {
+        if (adjacency(i).size() % 2 != 0) {
             odd++;
         }
     }
@@ -113,7 +186,7 @@ void Graph::findEulerCircuit() {
         size_t v = (size_t)stack.back();
 
         bool found = false;
-        for (auto& neighbor : adjList[v]) {
+        for (auto& neighbor : adjacency(v)) {
             if (!edgeVisited[{v, neighbor.first}]) {
                 edgeVisited[{v, neighbor.first}] = edgeVisited[{neighbor.first, v}] = true;
                 stack.push_back(neighbor.first);
@@ -135,22 +208,23 @@ void Graph::findEulerCircuit() {
 }
 
 void Graph::printGraph() {
-    for (size_t i = 0; i < (size_t)vertices; i++) {
-        cout << i << " -> ";
-        for (auto& neighbor : adjList[i]) {
-            cout << "(" << neighbor.first << ", " << neighbor.second << ") ";
-        }
-        cout << endl;
-    }
+    printGraph(cout);
 }
 
 void Graph::printGraph(ostream& os) {
+    string out;
+    printGraph(out);
+    os.write(out.data(), (streamsize)out.size());  // One write, instead of a flush per line
+}
+
+void Graph::printGraph(string& out) const {
+    ReplyWriter writer(out);
     for (size_t i = 0; i < (size_t)vertices; i++) {
-        os << i << " -> ";
-        for (auto& neighbor : adjList[i]) {
-            os << "(" << neighbor.first << ", " << neighbor.second << ") ";
+        writer << i << " -> ";
+        for (auto& neighbor : adjacency(i)) {
+            writer << '(' << neighbor.first << ", " << neighbor.second << ") ";
         }
-        os << endl;
+        writer << '\n';
     }
 }
 
@@ -158,12 +232,12 @@ int Graph::getVertices() const {
     return vertices;
 }
 
-const list<pair<int, double>>& Graph::getAdjList(size_t u) const {
-    return adjList[u];
+const vector<pair<int, double>>& Graph::getAdjList(size_t u) const {
+    return adjacency(u);
 }
 
 double Graph::getWeight(size_t u, size_t v) const {
-    for (const auto& neighbor : adjList[u]) {
+    for (const auto& neighbor : adjacency(u)) {
         if ((size_t)neighbor.first == v) {
             return neighbor.second;
         }
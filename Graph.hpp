@@ -6,14 +6,37 @@
 #include <map>
 #include <iostream>
 #include <utility>
+#include <cstdint>
+#include <string>
+#include <memory>
 
 using namespace std;
 
+/* Undirected weighted graph as adjacency lists.
+The lists live in a two-level tree of reference-counted pieces (branches of 256 leaves,
+leaves of 16 lists) that are shared between copies and cloned on write. Copying a Graph
+copies one pointer per 4096 vertices; an edit then clones only the branch and leaf that
+hold each list it changes. Different copies may be used from different threads.
+*/
 class Graph {
 public:
+    // One undirected edge, as uploaded in bulk
+    struct WeightedEdge {
+        uint32_t u;
+        uint32_t v;
+        double weight;
+    };
+
     Graph(int myVertices);
     void addEdge(size_t u, size_t v, double weight);
+    // Adds every edge or none: throws std::out_of_range if any endpoint is not a vertex
+    void addEdges(const vector<WeightedEdge>& edges);
     void removeEdge(size_t u, size_t v);
+    // Removes every edge or none: throws std::out_of_range if any endpoint is not a vertex
+    void removeEdges(const vector<pair<uint32_t, uint32_t>>& pairs);
+    // Replaces the adjacency list of u; safe to call concurrently for different vertices
+    // of a graph no copy has been taken of
+    void assignAdjacency(size_t u, const uint32_t* neighbors, const double* weights, size_t count);
     bool isConnected();
     void DFS(size_t v, vector<bool>& visited);
     int findStartVertex();
@@ -21,13 +44,33 @@ public:
     void findEulerCircuit();
     void printGraph();
     void printGraph(ostream& os);
+    void printGraph(string& out) const;  // Appends the same text, formatted without a stream
     int getVertices() const;
-    const list<pair<int, double>>& getAdjList(size_t u) const;
+    const vector<pair<int, double>>& getAdjList(size_t u) const;
     double getWeight(size_t u, size_t v) const;
 
 private:
+    using List = vector<pair<int, double>>;
+
+    static constexpr size_t LEAF_BITS = 4;
+    static constexpr size_t BRANCH_BITS = 8;
+    static constexpr size_t LEAF_SIZE = size_t(1) << LEAF_BITS;
+    static constexpr size_t BRANCH_SIZE = size_t(1) << BRANCH_BITS;
+
+    struct Leaf {
+        List lists[LEAF_SIZE];
+    };
+    struct Branch {
+        shared_ptr<Leaf> leaves[BRANCH_SIZE];
+    };
+
+    const List& adjacency(size_t u) const {
+        return branches[u >> (LEAF_BITS + BRANCH_BITS)]->leaves[(u >> LEAF_BITS) & (BRANCH_SIZE - 1)]->lists[u & (LEAF_SIZE - 1)];
+    }
+    List& mutableAdjacency(size_t u);  // Clones the pieces on the way that other copies share
+
     int vertices;
-    vector<list<pair<int, double>>> adjList;
+    vector<shared_ptr<Branch>> branches;
 };
 
 #endif // GRAPH_HPP
@@ -0,0 +1,293 @@
+#include "GraphCommands.hpp"
+#include "KruskalMST.hpp"
+#include "Clustering.hpp"
+#include "ReplyWriter.hpp"
+#include "Trace.hpp"
+#include <vector>
+#include <limits>
+
+namespace {
+
+const char* const NO_MST = "MST not computed yet. Please compute MST first.\n";
+
+// Reads a vertex below vertices; replies "Invalid vertex" if it is missing or out of range
+bool nextVertex(size_t vertices, CommandArgs& args, size_t& vertex, std::string& out) {
+    if (!args.next(vertex) || vertex >= vertices) {
+        out += "Invalid vertex\n";
+        return false;
+    }
+    return true;
+}
+
+// The bottleneck index is built lazily, by the first query after the graph changed
+void ensureIndex(GraphSession& session, const SharedGraph::Snapshot& snapshot) {
+    if (!session.krt.isValid() || session.krtVersion != snapshot.version) {
+        KruskalMST kruskal;
+        kruskal.computeMST(snapshot.graph, &session.krt);
+        session.krtVersion = snapshot.version;
+    }
+}
+
+} // namespace
+
+void GraphSession::attach(std::shared_ptr<SharedGraph> shared, std::string name) {
+    graph = std::move(shared);
+    graphName = std::move(name);
+    mst.reset();
+    krt.clear();
+}
+
+void GraphCommands::newGraph(GraphSession& session, CommandArgs& args, std::string& out) {
+    std::string_view first, second;
+    args.next(first);
+    args.next(second);
+    std::string_view count = second.empty() ? first : second;
+    int num_vertices;
+    if (!CommandArgs::parse(count, num_vertices) || num_vertices < 0) {
+        out += "Invalid vertex count\n";
+        return;
+    }
+    if (second.empty()) {
+        session.attach(std::make_shared<SharedGraph>(num_vertices), std::string());
+        ReplyWriter(out) << "New graph created with " << num_vertices << " vertices.\n";
+        return;
+    }
+    if (first.size() > GraphRegistry::MAX_NAME) {
+        ReplyWriter(out) << "Graph name too long (at most " << GraphRegistry::MAX_NAME << " bytes)\n";
+        return;
+    }
+    std::string name(first);
+    session.attach(GraphRegistry::shared().create(name, num_vertices), name);
+    ReplyWriter(out) << "New graph " << name << " created with " << num_vertices << " vertices.\n";
+}
+
+// Format "open_graph name": later commands work on the named graph, shared with other clients
+void GraphCommands::openGraph(GraphSession& session, CommandArgs& args, std::string& out) {
+    std::string_view token;
+    args.next(token);
+    std::string name(token);
+    std::shared_ptr<SharedGraph> shared = GraphRegistry::shared().find(name);
+    if (!shared) {
+        ReplyWriter(out) << "No graph named " << name << "\n";
+        return;
+    }
+    session.attach(std::move(shared), name);
+    ReplyWriter(out) << "Opened graph " << name << " with " << session.graph->snapshot()->graph.getVertices() << " vertices.\n";
+}
+
+// Format "add_edge vertex1 vertex2 weight"
+void GraphCommands::addEdge(GraphSession& session, CommandArgs& args, std::string& out) {
+    size_t v1, v2;
+    double weight;
+    if (!args.next(v1) || !args.next(v2)) {
+        out += "Invalid vertex\n";
+        return;
+    }
+    if (!args.next(weight)) {
+        out += "Invalid weight\n";
+        return;
+    }
+    if (!session.graph->addEdge(v1, v2, weight)) {
+        out += "Invalid vertex\n";
+        return;
+    }
+    ReplyWriter(out) << "Edge added between " << v1 << " and " << v2 << " with weight " << ReplyWriter::fixed(weight) << ".\n";
+}
+
+// Format "remove_edge vertex1 vertex2"
+void GraphCommands::removeEdge(GraphSession& session, CommandArgs& args, std::string& out) {
+    size_t v1, v2;
+    if (!args.next(v1) || !args.next(v2)) {
+        out += "Invalid vertex\n";
+        return;
+    }
+    if (!session.graph->removeEdge(v1, v2)) {
+        out += "Invalid vertex\n";
+        return;
+    }
+    ReplyWriter(out) << "Edge removed between " << v1 << " and " << v2 << ".\n";
+}
+
+void GraphCommands::printGraph(GraphSession& session, CommandArgs&, std::string& out) {
+    session.graph->snapshot()->graph.printGraph(out);
+}
+
+// Single-linkage clustering of the MST: format "cluster k1 [k2 ...]"
+void GraphCommands::cluster(GraphSession& session, CommandArgs& args, std::string& out) {
+    if (!session.mst || !session.mst->isValid()) {
+        out += NO_MST;
+        return;
+    }
+    std::vector<size_t> ks;
+    std::string_view token;
+    while (args.next(token)) {
+        size_t k;
+        if (!CommandArgs::parse(token, k) || k == 0 || k > session.mst->getVertices()) {
+            ks.clear();
+            break;
+        }
+        ks.push_back(k);
+    }
+    if (ks.empty()) {
+        out += "Invalid cluster count\n";
+        return;
+    }
+
+    SingleLinkage linkage(*session.mst);  // Sorts the MST edges once for every k
+    ReplyWriter writer(out);
+    for (const Clustering& clustering : linkage.cluster(ks)) {
+        writer << "Clusters (k=" << clustering.k << "): sizes";
+        for (size_t size : clustering.sizes) {
+            writer << ' ' << size;
+        }
+        writer << "\nLabels:";
+        for (uint32_t label : clustering.labels) {
+            writer << ' ' << label;
+        }
+        writer << '\n';
+    }
+}
+
+// Minimax edge on the MST path: format "bottleneck vertex1 vertex2"
+void GraphCommands::bottleneck(GraphSession& session, CommandArgs& args, std::string& out) {
+    std::shared_ptr<const SharedGraph::Snapshot> snapshot = session.graph->snapshot();
+    size_t vertices = (size_t)snapshot->graph.getVertices();
+    size_t v1, v2;
+    if (!nextVertex(vertices, args, v1, out) || !nextVertex(vertices, args, v2, out)) {
+        return;
+    }
+    ensureIndex(session, *snapshot);
+    double weight = session.krt.bottleneck(v1, v2);
+    ReplyWriter writer(out);
+    if (weight == std::numeric_limits<double>::infinity()) {
+        writer << "Vertices " << v1 << " and " << v2 << " are not connected.\n";
+    } else {
+        writer << "Bottleneck edge between " << v1 << " and " << v2 << ": " << weight << "\n";
+    }
+}
+
+// Component of a vertex using only edges <= w: format "reachable_under vertex weight"
+void GraphCommands::reachableUnder(GraphSession& session, CommandArgs& args, std::string& out) {
+    std::shared_ptr<const SharedGraph::Snapshot> snapshot = session.graph->snapshot();
+    size_t v1;
+    double limit;
+    if (!nextVertex((size_t)snapshot->graph.getVertices(), args, v1, out)) {
+        return;
+    }
+    if (!args.next(limit)) {
+        out += "Invalid weight\n";
+        return;
+    }
+    ensureIndex(session, *snapshot);
+    KruskalReconstructionTree::Component component = session.krt.reachableUnder(v1, limit);
+    ReplyWriter(out) << "Component " << component.id << " of size " << component.size << "\n";
+}
+
+void GraphCommands::mstData(GraphSession& session, CommandArgs&, std::string& out) {
+    if (!session.mst || !session.mst->isValid()) {
+        out += NO_MST;
+        return;
+    }
+    TreeMetrics metrics = session.mst->calculateMetrics();  // One pass computes all four
+    ReplyWriter writer(out);
+    writer << "MST Data:\n";
+    writer << "Total Weight: " << metrics.totalWeight << "\n";
+    writer << "Longest Distance: " << metrics.longestDistance << "\n";
+    writer << "Average Distance: " << metrics.averageDistance << "\n";
+    writer << "Shortest Distance: " << metrics.shortestDistance << "\n";
+}
+
+void GraphCommands::stats(GraphSession&, CommandArgs&, std::string& out) {
+    Stats::writeText(out);
+}
+
+void GraphCommands::trace(GraphSession&, CommandArgs& args, std::string& out) {
+    if (!Trace::ENABLED) {
+        out += "Tracing is not compiled in (rebuild with make clean; make TRACE=1)\n";
+        return;
+    }
+    std::string_view mode;
+    args.next(mode);
+    if (mode == "clear") {
+        Trace::clear();
+        out += "Trace cleared.\n";
+        return;
+    }
+    Trace::writeChromeJson(out);
+    out += '\n';
+}
+
+void GraphCommands::ping(GraphSession&, CommandArgs&, std::string& out) {
+    out += "pong\n";
+}
+
+void GraphCommands::mst(GraphSession& session, CommandArgs& args, std::string& out) {
+    MstRequest request;
+    uint64_t start = Stats::now();
+    if (!parseMst(args, request, out)) {
+        return;
+    }
+    Stats::record(mstTiming(request.algorithm, MstPhase::PARSE), Stats::now() - start);
+    computeMst(session, request.algorithm);
+    ScopedTimer format(mstTiming(request.algorithm, MstPhase::FORMAT));
+    if (request.binary) {
+        writeBinaryMst(*session.mst, request, out);
+    } else {
+        ReplyWriter(out) << "MST Computed using " << MSTFactory::name(request.algorithm) << ":\n";
+        session.mst->printTree(out);
+    }
+}
+
+bool GraphCommands::parseMst(CommandArgs& args, MstRequest& request, std::string& out) {
+    std::string_view algorithm, mode, encoding;
+    args.next(algorithm);
+    args.next(mode);
+    args.next(encoding);
+    // Optional "binary [varint]" suffix selects the TreeSerializer response
+    request.binary = (mode == "binary");
+    if ((!mode.empty() && !request.binary) || (!encoding.empty() && encoding != "varint")) {
+        out += "Unknown MST response mode\n";
+        return false;
+    }
+    request.encoding = encoding == "varint" ? TreeSerializer::Encoding::VARINT : TreeSerializer::Encoding::PLAIN;
+    if (!MSTFactory::fromName(algorithm, request.algorithm)) {
+        out += "Unknown MST algorithm\n";
+        return false;
+    }
+    return true;
+}
+
+void GraphCommands::computeMst(GraphSession& session, MSTFactory::Algorithm algorithm) {
+    // Writers keep going meanwhile; this MST is of the graph as it was when it started
+    std::shared_ptr<const SharedGraph::Snapshot> snapshot = session.graph->snapshot();
+    ScopedTimer timer(mstTiming(algorithm, MstPhase::COMPUTE));
+    if (algorithm == MSTFactory::Algorithm::KRUSKAL) {
+        KruskalMST kruskal;  // Also emits the reconstruction tree for bottleneck queries
+        session.mst = std::make_shared<const Tree>(kruskal.computeMST(snapshot->graph, &session.krt));
+        session.krtVersion = snapshot->version;
+    } else {
+        session.mst = std::make_shared<const Tree>(MSTFactory::createMSTStrategy(algorithm)->computeMST(snapshot->graph));
+    }
+}
+
+void GraphCommands::writeBinaryMst(const Tree& tree, const MstRequest& request, std::string& out) {
+    // Header line with the payload size, then the encoded tree
+    std::string blob;
+    TreeSerializer::write(tree, blob, request.encoding);
+    ReplyWriter(out) << "MST Computed using " << MSTFactory::name(request.algorithm) << " (binary, " << blob.size() << " bytes):\n" << blob;
+}
+
+Stats::Id GraphCommands::mstTiming(MSTFactory::Algorithm algorithm, MstPhase phase) {
+    static const char* const PHASES[] = {"parse", "compute", "format"};
+    static const std::vector<Stats::Id> histograms = [] {
+        std::vector<Stats::Id> ids;
+        for (int a = 0; a <= static_cast<int>(MSTFactory::Algorithm::Integer); ++a) {
+            std::string labels = std::string("algorithm=\"") + MSTFactory::name(static_cast<MSTFactory::Algorithm>(a)) + "\",phase=\"";
+            for (const char* name : PHASES) {
+                ids.push_back(Stats::histogram("mst_phase_seconds", labels + name + "\""));
+            }
+        }
+        return ids;
+    }();
+    return histograms[static_cast<size_t>(algorithm) * 3 + static_cast<size_t>(phase)];
+}
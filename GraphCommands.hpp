@@ -0,0 +1,86 @@
+#ifndef GRAPHCOMMANDS_HPP
+#define GRAPHCOMMANDS_HPP
+
+#include <string>
+#include <memory>
+#include "CommandTable.hpp"
+#include "Graph.hpp"
+#include "GraphRegistry.hpp"
+#include "Tree.hpp"
+#include "MSTFactory.hpp"
+#include "ReconstructionTree.hpp"
+#include "TreeSerializer.hpp"
+#include "Stats.hpp"
+
+// The graph state of one client, common to both servers (each extends it with its own fields)
+struct GraphSession {
+    std::shared_ptr<SharedGraph> graph = std::make_shared<SharedGraph>(5);  // Private until a named one is opened
+    std::string graphName;            // Empty for a private graph
+    std::shared_ptr<const Tree> mst;  // Last computed MST; read-only, so it can be shared
+    KruskalReconstructionTree krt;    // Bottleneck index of the snapshot krtVersion
+    uint64_t krtVersion = 0;
+
+    // Switches to another graph; the MST and the index belong to the old one
+    void attach(std::shared_ptr<SharedGraph> shared, std::string name);
+};
+
+// Handlers of the text commands both servers understand, and the pieces of the MST command
+class GraphCommands {
+public:
+    // "MST <algorithm> [binary [varint]]"
+    struct MstRequest {
+        MSTFactory::Algorithm algorithm = MSTFactory::Algorithm::KRUSKAL;
+        bool binary = false;
+        TreeSerializer::Encoding encoding = TreeSerializer::Encoding::PLAIN;
+    };
+
+    // The parts of an MST request timed separately, per algorithm (sending is timed by the front end)
+    enum class MstPhase { PARSE, COMPUTE, FORMAT };
+
+    // Registers new_graph, open_graph, add_edge, remove_edge, print_graph, cluster, bottleneck,
+    // reachable_under, stats, trace and ping; Context must derive from GraphSession
+    template <typename Context>
+    static void addTo(CommandTable<Context>& table) {
+        table.add("new_graph", newGraph);
+        table.add("open_graph", openGraph);
+        table.add("add_edge", addEdge);
+        table.add("remove_edge", removeEdge);
+        table.add("print_graph", printGraph);
+        table.add("cluster", cluster);
+        table.add("bottleneck", bottleneck);
+        table.add("reachable_under", reachableUnder);
+        table.add("stats", stats);
+        table.add("trace", trace);
+        table.add("ping", ping);
+    }
+
+    // "new_graph V" starts a private graph, "new_graph name V" creates or resets a shared one
+    static void newGraph(GraphSession& session, CommandArgs& args, std::string& out);
+    static void openGraph(GraphSession& session, CommandArgs& args, std::string& out);
+    static void addEdge(GraphSession& session, CommandArgs& args, std::string& out);
+    static void removeEdge(GraphSession& session, CommandArgs& args, std::string& out);
+    static void printGraph(GraphSession& session, CommandArgs& args, std::string& out);
+    static void cluster(GraphSession& session, CommandArgs& args, std::string& out);
+    static void bottleneck(GraphSession& session, CommandArgs& args, std::string& out);
+    static void reachableUnder(GraphSession& session, CommandArgs& args, std::string& out);
+    static void mstData(GraphSession& session, CommandArgs& args, std::string& out);
+    // The counters and latency histograms of this process (Stats::writeText)
+    static void stats(GraphSession& session, CommandArgs& args, std::string& out);
+    // "trace" replies with the MST phase spans as Chrome trace JSON, "trace clear" starts over
+    static void trace(GraphSession& session, CommandArgs& args, std::string& out);
+    // Replies "pong": sent after other commands, it tells a client where their replies end
+    static void ping(GraphSession& session, CommandArgs& args, std::string& out);
+    // Computes the MST and replies with it as text or as a TreeSerializer image
+    static void mst(GraphSession& session, CommandArgs& args, std::string& out);
+
+    // On failure, appends the error reply to out and returns false
+    static bool parseMst(CommandArgs& args, MstRequest& request, std::string& out);
+    // Replaces session.mst, computed on the current snapshot; Kruskal also rebuilds the bottleneck index
+    static void computeMst(GraphSession& session, MSTFactory::Algorithm algorithm);
+    // "MST Computed using <name> (binary, <n> bytes):\n" followed by the image
+    static void writeBinaryMst(const Tree& tree, const MstRequest& request, std::string& out);
+    // mst_phase_seconds{algorithm, phase}; computeMst records COMPUTE itself
+    static Stats::Id mstTiming(MSTFactory::Algorithm algorithm, MstPhase phase);
+};
+
+#endif // GRAPHCOMMANDS_HPP
@@ -0,0 +1,180 @@
+#include "GraphRegistry.hpp"
+#include "WireProtocol.hpp"
+#include <stdexcept>
+
+SharedGraph::SharedGraph(int vertices)
+    : draft_(vertices), published_(std::make_shared<const Snapshot>(Snapshot{Graph(vertices), 0, 0})) {}
+
+// Published by the first snapshot() rather than copied here: restarts only build each graph once
+SharedGraph::SharedGraph(Graph graph, uint64_t lsn)
+    : draft_(std::move(graph)), draftVersion_(1), lsn_(lsn), published_(std::make_shared<const Snapshot>(Snapshot{Graph(0), 0, 0})) {}
+
+std::shared_ptr<const SharedGraph::Snapshot> SharedGraph::snapshot() {
+    std::shared_ptr<const Snapshot> current = std::atomic_load(&published_);
+    if (current->version == draftVersion_.load(std::memory_order_acquire)) {
+        return current;  // The common case: no edit since the last publication, no lock
+    }
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    current = std::atomic_load(&published_);
+    uint64_t version = draftVersion_.load(std::memory_order_relaxed);
+    if (current->version != version) {
+        current = std::make_shared<const Snapshot>(Snapshot{draft_, version, lsn_});
+        std::atomic_store(&published_, current);
+    }
+    return current;
+}
+
+void SharedGraph::reset(int vertices) {
+    Graph empty(vertices);  // Built outside the edit, which only swaps it in
+    edit(Journal::Record::CREATE,
+         [&empty](Graph& draft) {
+             draft = std::move(empty);
+             return true;
+         },
+         [vertices](std::string& out) { WireProtocol::putU32(out, (uint32_t)vertices); });
+}
+
+bool SharedGraph::addEdge(size_t u, size_t v, double weight) {
+    return edit(Journal::Record::ADD_EDGES,
+                [&](Graph& draft) {
+                    if (u >= (size_t)draft.getVertices() || v >= (size_t)draft.getVertices()) {
+                        return false;
+                    }
+                    draft.addEdge(u, v, weight);
+                    return true;
+                },
+                [&](std::string& out) {
+                    WireProtocol::putU32(out, 1);
+                    WireProtocol::putU32(out, (uint32_t)u);
+                    WireProtocol::putU32(out, (uint32_t)v);
+                    WireProtocol::putF64(out, weight);
+                });
+}
+
+void SharedGraph::addEdges(const std::vector<Graph::WeightedEdge>& edges) {
+    edit(Journal::Record::ADD_EDGES,
+         [&edges](Graph& draft) {
+             draft.addEdges(edges);
+             return true;
+         },
+         [&edges](std::string& out) {
+             out.reserve(out.size() + 4 + edges.size() * 16);
+             WireProtocol::putU32(out, (uint32_t)edges.size());
+             for (const Graph::WeightedEdge& edge : edges) {
+                 WireProtocol::putU32(out, edge.u);
+                 WireProtocol::putU32(out, edge.v);
+                 WireProtocol::putF64(out, edge.weight);
+             }
+         });
+}
+
+bool SharedGraph::removeEdge(size_t u, size_t v) {
+    return edit(Journal::Record::REMOVE_EDGES,
+                [&](Graph& draft) {
+                    if (u >= (size_t)draft.getVertices() || v >= (size_t)draft.getVertices()) {
+                        return false;
+                    }
+                    draft.removeEdge(u, v);
+                    return true;
+                },
+                [&](std::string& out) {
+                    WireProtocol::putU32(out, 1);
+                    WireProtocol::putU32(out, (uint32_t)u);
+                    WireProtocol::putU32(out, (uint32_t)v);
+                });
+}
+
+void SharedGraph::removeEdges(const std::vector<std::pair<uint32_t, uint32_t>>& pairs) {
+    edit(Journal::Record::REMOVE_EDGES,
+         [&pairs](Graph& draft) {
+             draft.removeEdges(pairs);
+             return true;
+         },
+         [&pairs](std::string& out) {
+             out.reserve(out.size() + 4 + pairs.size() * 8);
+             WireProtocol::putU32(out, (uint32_t)pairs.size());
+             for (const auto& pair : pairs) {
+                 WireProtocol::putU32(out, pair.first);
+                 WireProtocol::putU32(out, pair.second);
+             }
+         });
+}
+
+void SharedGraph::persist(Journal* journal, std::string name, uint64_t lsn) {
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    journal_ = journal;
+    name_ = std::move(name);
+    lsn_ = lsn;
+    // Republished, so that snapshots carry the LSN
+    draftVersion_.store(draftVersion_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+GraphRegistry& GraphRegistry::shared() {
+    static GraphRegistry registry;
+    return registry;
+}
+
+std::shared_ptr<SharedGraph> GraphRegistry::find(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = graphs_.find(name);
+    return it == graphs_.end() ? nullptr : it->second;
+}
+
+std::shared_ptr<SharedGraph> GraphRegistry::create(const std::string& name, int vertices) {
+    if (name.size() > MAX_NAME) {
+        throw std::length_error("Graph name too long (at most " + std::to_string(MAX_NAME) + " bytes)");
+    }
+    std::shared_ptr<SharedGraph> graph;
+    bool created = false;
+    Journal* journal = nullptr;
+    uint64_t lsn = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (journal_ != nullptr) {
+            journal_->checkWritable();  // Before the entry exists, so a refused create leaves nothing behind
+        }
+        std::shared_ptr<SharedGraph>& entry = graphs_[name];
+        if (entry) {
+            graph = entry;
+        } else {
+            entry = std::make_shared<SharedGraph>(vertices);
+            graph = entry;
+            created = true;
+            if (journal_ != nullptr) {
+                // Logged under the registry lock: any later edit of the graph comes after it
+                journal = journal_;
+                lsn = journal->append(Journal::Record::CREATE, name, [vertices](std::string& out) {
+                    WireProtocol::putU32(out, (uint32_t)vertices);
+                });
+                graph->persist(journal, name, lsn);
+            }
+        }
+    }
+    if (!created) {
+        graph->reset(vertices);
+    } else if (journal != nullptr) {
+        journal->waitDurable(lsn);
+    }
+    return graph;
+}
+
+void GraphRegistry::persist(Journal* journal) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    journal_ = journal;
+}
+
+void GraphRegistry::restore(const std::string& name, std::shared_ptr<SharedGraph> graph) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    graphs_[name] = std::move(graph);
+}
+
+void GraphRegistry::forEach(const std::function<void(const std::string&, const std::shared_ptr<SharedGraph>&)>& visit) const {
+    std::vector<std::pair<std::string, std::shared_ptr<SharedGraph>>> graphs;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        graphs.assign(graphs_.begin(), graphs_.end());
+    }
+    for (const auto& entry : graphs) {
+        visit(entry.first, entry.second);
+    }
+}
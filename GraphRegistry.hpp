@@ -0,0 +1,125 @@
+#ifndef GRAPHREGISTRY_HPP
+#define GRAPHREGISTRY_HPP
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <functional>
+#include <cstdint>
+#include "Graph.hpp"
+#include "Journal.hpp"
+
+/* A graph that any number of connections read and edit concurrently.
+Writers take turns editing a private draft under writeMutex_. Readers never see the draft:
+they get an immutable Snapshot through an atomic shared_ptr, so an MST or a metrics
+computation works on one consistent graph from start to end however long it takes and
+whatever writers do meanwhile. A reader only takes the mutex when the draft has changed
+since the last snapshot; the first one to notice publishes a copy of it, and the following
+readers share that copy. Graph copies share their adjacency lists copy-on-write, so the
+copy takes one pointer per 4096 vertices and the next edits clone only what they change:
+writers wait for readers only that long, never for a copy of the graph. Old snapshots are
+freed when their last reader drops them (the reference count stands in for an RCU grace
+period).
+A persistent graph also appends every edit to a Journal while it still holds the mutex, so
+the journal has the edits of each graph in the order they were applied, then waits outside
+the mutex until the record is on disk: the edit returns (and its client is answered) only
+once it is durable, while other clients may already read it.
+*/
+class SharedGraph {
+public:
+    struct Snapshot {
+        Graph graph;
+        uint64_t version;  // Increases with every edit of this SharedGraph
+        uint64_t lsn;      // Last journal record included (0 for a graph that is not persistent)
+    };
+
+    explicit SharedGraph(int vertices);
+    // A graph loaded from a snapshot that includes the journal up to lsn
+    SharedGraph(Graph graph, uint64_t lsn);
+
+    // The graph with every edit made so far; waits only for an edit in progress
+    std::shared_ptr<const Snapshot> snapshot();
+
+    // Edits, visible to the next snapshot(). Vertices are checked against the draft: another
+    // client may have replaced the graph since this one last looked at it
+    void reset(int vertices);
+    bool addEdge(size_t u, size_t v, double weight);  // False if u or v is not a vertex
+    void addEdges(const std::vector<Graph::WeightedEdge>& edges);  // All or none, like Graph::addEdges
+    bool removeEdge(size_t u, size_t v);
+    void removeEdges(const std::vector<std::pair<uint32_t, uint32_t>>& pairs);
+
+    // Journals the edits made from now on as those of the graph called name, whose journal
+    // so far ends at lsn
+    void persist(Journal* journal, std::string name, uint64_t lsn);
+
+private:
+    /* Runs change(Graph&) on the draft, serialized with other edits. When it returns true
+    and the graph is persistent, encode(std::string&) writes the payload of the journal record
+    before the lock is released, and the call returns once the record is on disk. Throws
+    std::runtime_error if the journal cannot write (before changing anything if it already
+    knows).
+    */
+    template <typename Change, typename Encode>
+    bool edit(Journal::Record type, Change&& change, Encode&& encode) {
+        Journal* journal;
+        uint64_t lsn = 0;
+        {
+            std::lock_guard<std::mutex> lock(writeMutex_);
+            journal = journal_;
+            if (journal != nullptr) {
+                journal->checkWritable();
+            }
+            if (!change(draft_)) {
+                return false;  // Nothing changed: readers keep the published snapshot
+            }
+            if (journal != nullptr) {
+                lsn = lsn_ = journal->append(type, name_, encode);
+            }
+            draftVersion_.store(draftVersion_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+        if (journal != nullptr) {
+            journal->waitDurable(lsn);  // Group commit: shares the disk flush with concurrent edits
+        }
+        return true;
+    }
+
+    std::mutex writeMutex_;
+    Graph draft_;
+    std::atomic<uint64_t> draftVersion_{0};
+    uint64_t lsn_ = 0;
+    Journal* journal_ = nullptr;
+    std::string name_;
+    std::shared_ptr<const Snapshot> published_;  // Accessed with std::atomic_load/atomic_store only
+};
+
+// Named graphs, shared by every connection of the server
+class GraphRegistry {
+public:
+    static GraphRegistry& shared();
+
+    // nullptr if there is no graph of that name
+    std::shared_ptr<SharedGraph> find(const std::string& name) const;
+    // Longest graph name, in bytes: the name goes into a snapshot file name (as hex) and a
+    // journal record (with a u16 length)
+    static constexpr size_t MAX_NAME = 100;
+
+    // Creates the graph, or replaces its contents if it exists (connections that opened it see the new graph);
+    // throws std::length_error for a name longer than MAX_NAME
+    std::shared_ptr<SharedGraph> create(const std::string& name, int vertices);
+
+    // Graphs created from now on are journaled (GraphStore sets it once recovery is done)
+    void persist(Journal* journal);
+    // Adds a graph loaded from a snapshot, replacing any of the same name
+    void restore(const std::string& name, std::shared_ptr<SharedGraph> graph);
+    // Calls visit(name, graph) for every graph, outside the registry lock
+    void forEach(const std::function<void(const std::string&, const std::shared_ptr<SharedGraph>&)>& visit) const;
+
+private:
+    mutable std::mutex mutex_;
+    Journal* journal_ = nullptr;
+    std::unordered_map<std::string, std::shared_ptr<SharedGraph>> graphs_;
+};
+
+#endif // GRAPHREGISTRY_HPP
@@ -0,0 +1,383 @@
+#include "GraphStore.hpp"
+#include "ThreadPool.hpp"
+#include "WireProtocol.hpp"
+#include "Logger.hpp"
+#include <chrono>
+#include <limits>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+
+const char SNAPSHOT_MAGIC[4] = {'M', 'S', 'T', 'G'};
+const uint32_t SNAPSHOT_FORMAT = 1;
+const char SNAPSHOT_PREFIX[] = "graph-";
+const char SNAPSHOT_SUFFIX[] = ".snap";
+const size_t WRITE_CHUNK = 4 << 20;
+const size_t LOAD_GRAIN = 4096;  // Vertices per parallel piece when loading
+
+struct SnapshotHeader {
+    char magic[4];
+    uint32_t format;
+    uint64_t lsn;
+    uint64_t entries;  // Adjacency entries: twice the edges
+    uint32_t vertices;
+    uint32_t nameLength;
+};
+
+size_t padded(size_t bytes) {
+    return (bytes + 7) & ~size_t(7);
+}
+
+// Buffers a file's contents into large writes
+class FileWriter {
+public:
+    explicit FileWriter(int fd) : fd_(fd) {
+        buffer_.reserve(WRITE_CHUNK);
+    }
+
+    void put(const void* data, size_t size) {
+        buffer_.append(static_cast<const char*>(data), size);
+        if (buffer_.size() >= WRITE_CHUNK) {
+            flush();
+        }
+    }
+
+    void pad() {
+        buffer_.append(padded(written_ + buffer_.size()) - (written_ + buffer_.size()), '\0');
+    }
+
+    // Writes what is buffered and syncs; false if anything failed
+    bool finish() {
+        flush();
+        return ok_ && fsync(fd_) == 0;
+    }
+
+private:
+    void flush() {
+        const char* data = buffer_.data();
+        size_t left = buffer_.size();
+        while (ok_ && left > 0) {
+            ssize_t written = write(fd_, data, left);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            ok_ = written > 0;
+            if (ok_) {
+                data += written;
+                left -= (size_t)written;
+            }
+        }
+        written_ += buffer_.size();
+        buffer_.clear();
+    }
+
+    int fd_;
+    std::string buffer_;
+    size_t written_ = 0;
+    bool ok_ = true;
+};
+
+std::string hexName(const std::string& name) {
+    static const char DIGITS[] = "0123456789abcdef";
+    std::string hex;
+    for (char c : name) {
+        unsigned char byte = static_cast<unsigned char>(c);
+        hex.push_back(DIGITS[byte >> 4]);
+        hex.push_back(DIGITS[byte & 15]);
+    }
+    return hex;
+}
+
+void syncDirectory(const std::string& directory) {
+    int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd != -1) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+} // namespace
+
+GraphStore::GraphStore(Options options, GraphRegistry& registry) : options_(std::move(options)), registry_(registry) {}
+
+GraphStore::~GraphStore() {
+    {
+        std::lock_guard<std::mutex> lock(stopMutex_);
+        stop_ = true;
+    }
+    stopCondition_.notify_all();
+    if (checkpointer_.joinable()) {
+        checkpointer_.join();
+    }
+    registry_.persist(nullptr);
+    journal_.reset();  // Commits the last records
+}
+
+size_t GraphStore::open() {
+    auto start = std::chrono::steady_clock::now();
+    if (mkdir(options_.directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::runtime_error("GraphStore: cannot create " + options_.directory + ": " + std::strerror(errno));
+    }
+
+    // Newest state of every graph: its snapshot, then the journal records after it
+    std::unordered_map<std::string, uint64_t> applied;
+    uint64_t lastLsn = 0;
+    if (DIR* dir = opendir(options_.directory.c_str())) {
+        const size_t prefix = sizeof SNAPSHOT_PREFIX - 1, suffix = sizeof SNAPSHOT_SUFFIX - 1;
+        while (struct dirent* entry = readdir(dir)) {
+            std::string file = entry->d_name;
+            if (file.size() <= prefix + suffix || file.compare(0, prefix, SNAPSHOT_PREFIX) != 0 ||
+                file.compare(file.size() - suffix, suffix, SNAPSHOT_SUFFIX) != 0) {
+                continue;
+            }
+            std::string name;
+            std::shared_ptr<SharedGraph> graph;
+            uint64_t lsn;
+            if (loadSnapshot(options_.directory + "/" + file, name, graph, lsn)) {
+                registry_.restore(name, std::move(graph));
+                applied[name] = persisted_[name] = lsn;
+                lastLsn = std::max(lastLsn, lsn);
+            }
+        }
+        closedir(dir);
+    }
+    size_t snapshots = applied.size();
+    replayJournal(applied);
+    for (const auto& entry : applied) {
+        lastLsn = std::max(lastLsn, entry.second);
+    }
+
+    journal_ = std::make_unique<Journal>(options_.directory, lastLsn + 1, options_.commitIntervalMs);
+    registry_.persist(journal_.get());
+    size_t graphs = 0;
+    registry_.forEach([&](const std::string& name, const std::shared_ptr<SharedGraph>& graph) {
+        graph->persist(journal_.get(), name, applied[name]);
+        ++graphs;
+    });
+    checkpointer_ = std::thread(&GraphStore::checkpointLoop, this);
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    LOG(INFO) << "Recovered " << graphs << " graphs (" << snapshots << " from snapshots) from "
+              << options_.directory << " in " << elapsed.count() << " s";
+    return graphs;
+}
+
+void GraphStore::replayJournal(std::unordered_map<std::string, uint64_t>& applied) {
+    // Runs before the registry is journaled, so replayed edits are not logged again
+    Journal::replay(options_.directory, [&](uint64_t lsn, Journal::Record type, std::string_view graph, std::string_view payload) {
+        std::string name(graph);
+        uint64_t& last = applied[name];
+        if (lsn <= last) {
+            return;  // Already in the snapshot
+        }
+        try {
+            WireProtocol::Reader reader(payload);
+            std::shared_ptr<SharedGraph> shared = type == Journal::Record::CREATE ? nullptr : registry_.find(name);
+            switch (type) {
+                case Journal::Record::CREATE:
+                    registry_.create(name, (int)reader.u32());
+                    break;
+                case Journal::Record::ADD_EDGES: {
+                    std::vector<Graph::WeightedEdge> edges(reader.u32());
+                    for (Graph::WeightedEdge& edge : edges) {
+                        edge.u = reader.u32();
+                        edge.v = reader.u32();
+                        edge.weight = reader.f64();
+                    }
+                    if (shared) {
+                        shared->addEdges(edges);
+                    }
+                    break;
+                }
+                case Journal::Record::REMOVE_EDGES: {
+                    std::vector<std::pair<uint32_t, uint32_t>> pairs(reader.u32());
+                    for (auto& pair : pairs) {
+                        pair.first = reader.u32();
+                        pair.second = reader.u32();
+                    }
+                    if (shared) {
+                        shared->removeEdges(pairs);
+                    }
+                    break;
+                }
+            }
+        } catch (const std::exception& e) {
+            LOG(WARN) << "GraphStore: skipping journal record " << lsn << " of " << name << ": " << e.what();
+        }
+        last = lsn;
+    });
+}
+
+void GraphStore::checkpoint() {
+    std::lock_guard<std::mutex> lock(checkpointMutex_);
+    bool changed = false;
+    registry_.forEach([&](const std::string& name, const std::shared_ptr<SharedGraph>& graph) {
+        auto it = persisted_.find(name);
+        changed = changed || it == persisted_.end() || it->second != graph->snapshot()->lsn;
+    });
+    if (!changed) {
+        return;
+    }
+
+    // Records below cut are in the old segments; every graph is checked again after the
+    // rotation, so an edit made meanwhile is either in a snapshot or in the new segment
+    uint64_t cut = journal_->rotate();
+    bool complete = true;
+    registry_.forEach([&](const std::string& name, const std::shared_ptr<SharedGraph>& graph) {
+        std::shared_ptr<const SharedGraph::Snapshot> snapshot = graph->snapshot();
+        auto it = persisted_.find(name);
+        if (it != persisted_.end() && it->second == snapshot->lsn) {
+            return;
+        }
+        if (writeSnapshot(name, *snapshot)) {
+            persisted_[name] = snapshot->lsn;
+        } else {
+            complete = false;
+        }
+    });
+    if (complete) {
+        journal_->removeSegmentsBefore(cut);
+    }
+}
+
+void GraphStore::commitNow() {
+    if (journal_) {
+        journal_->commit();
+    }
+}
+
+void GraphStore::checkpointLoop() {
+    auto last = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(stopMutex_);
+    while (!stopCondition_.wait_for(lock, std::chrono::seconds(1), [this] { return stop_; })) {
+        auto now = std::chrono::steady_clock::now();
+        if (now - last < std::chrono::seconds(options_.snapshotSeconds) && journal_->segmentBytes() < options_.journalLimit) {
+            continue;
+        }
+        lock.unlock();
+        checkpoint();
+        last = std::chrono::steady_clock::now();
+        lock.lock();
+    }
+}
+
+std::string GraphStore::snapshotPath(const std::string& name) const {
+    return options_.directory + "/" + SNAPSHOT_PREFIX + hexName(name) + SNAPSHOT_SUFFIX;
+}
+
+bool GraphStore::writeSnapshot(const std::string& name, const SharedGraph::Snapshot& snapshot) const {
+    const Graph& graph = snapshot.graph;
+    size_t vertices = (size_t)graph.getVertices();
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof header.magic);
+    header.format = SNAPSHOT_FORMAT;
+    header.lsn = snapshot.lsn;
+    header.vertices = (uint32_t)vertices;
+    header.nameLength = (uint32_t)name.size();
+    for (size_t u = 0; u < vertices; ++u) {
+        header.entries += graph.getAdjList(u).size();
+    }
+
+    std::string path = snapshotPath(name), temporary = path + ".tmp";
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        LOG(ERROR) << "GraphStore: cannot write " << temporary << ": " << std::strerror(errno);
+        return false;
+    }
+    FileWriter writer(fd);
+    writer.put(&header, sizeof header);
+    writer.put(name.data(), name.size());
+    writer.pad();
+    uint64_t offset = 0;
+    writer.put(&offset, sizeof offset);
+    for (size_t u = 0; u < vertices; ++u) {
+        offset += graph.getAdjList(u).size();
+        writer.put(&offset, sizeof offset);
+    }
+    for (size_t u = 0; u < vertices; ++u) {
+        for (const auto& neighbor : graph.getAdjList(u)) {
+            uint32_t v = (uint32_t)neighbor.first;
+            writer.put(&v, sizeof v);
+        }
+    }
+    writer.pad();
+    for (size_t u = 0; u < vertices; ++u) {
+        for (const auto& neighbor : graph.getAdjList(u)) {
+            writer.put(&neighbor.second, sizeof neighbor.second);
+        }
+    }
+    bool ok = writer.finish();
+    close(fd);
+    if (!ok || rename(temporary.c_str(), path.c_str()) != 0) {
+        LOG(ERROR) << "GraphStore: cannot write " << path << ": " << std::strerror(errno);
+        unlink(temporary.c_str());
+        return false;
+    }
+    syncDirectory(options_.directory);
+    return true;
+}
+
+bool GraphStore::loadSnapshot(const std::string& path, std::string& name, std::shared_ptr<SharedGraph>& graph, uint64_t& lsn) const {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (fd == -1 || fstat(fd, &info) != 0) {
+        LOG(ERROR) << "GraphStore: cannot read " << path << ": " << std::strerror(errno);
+        if (fd != -1) {
+            close(fd);
+        }
+        return false;
+    }
+    size_t size = (size_t)info.st_size;
+    void* mapped = size >= sizeof(SnapshotHeader) ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        LOG(ERROR) << "GraphStore: cannot map " << path;
+        return false;
+    }
+    madvise(mapped, size, MADV_WILLNEED);
+    const char* data = static_cast<const char*>(mapped);
+
+    SnapshotHeader header;
+    std::memcpy(&header, data, sizeof header);
+    size_t nameBytes = padded(header.nameLength);
+    size_t offsetsAt = sizeof header + nameBytes;
+    size_t neighborsAt = offsetsAt + ((size_t)header.vertices + 1) * sizeof(uint64_t);
+    size_t weightsAt = neighborsAt + padded((size_t)header.entries * sizeof(uint32_t));
+    bool valid = std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof header.magic) == 0 && header.format == SNAPSHOT_FORMAT &&
+                 header.vertices <= (uint32_t)std::numeric_limits<int>::max() &&
+                 weightsAt + (size_t)header.entries * sizeof(double) == size;
+    const uint64_t* offsets = reinterpret_cast<const uint64_t*>(data + offsetsAt);
+    for (size_t u = 0; valid && u < header.vertices; ++u) {
+        valid = offsets[u] <= offsets[u + 1];
+    }
+    valid = valid && offsets[0] == 0 && offsets[header.vertices] == header.entries;
+    if (!valid) {
+        LOG(ERROR) << "GraphStore: " << path << " is not a valid snapshot";
+        munmap(mapped, size);
+        return false;
+    }
+
+    name.assign(data + sizeof header, header.nameLength);
+    const uint32_t* neighbors = reinterpret_cast<const uint32_t*>(data + neighborsAt);
+    const double* weights = reinterpret_cast<const double*>(data + weightsAt);
+    Graph loaded((int)header.vertices);
+    // Each vertex's list is allocated and filled independently, so pieces run in parallel
+    parallelFor(WorkStealingPool::compute(), 0, header.vertices, LOAD_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t u = begin; u < end; ++u) {
+            size_t first = offsets[u];
+            loaded.assignAdjacency(u, neighbors + first, weights + first, offsets[u + 1] - first);
+        }
+    });
+    munmap(mapped, size);
+    lsn = header.lsn;
+    graph = std::make_shared<SharedGraph>(std::move(loaded), lsn);
+    return true;
+}
@@ -0,0 +1,69 @@
+#ifndef GRAPHSTORE_HPP
+#define GRAPHSTORE_HPP
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <unordered_map>
+#include <cstdint>
+#include "GraphRegistry.hpp"
+#include "Journal.hpp"
+
+/* Keeps the named graphs of a GraphRegistry across restarts.
+Every edit of a named graph goes to the Journal; a checkpoint thread periodically writes a
+snapshot of each graph that changed and then drops the journal segments the snapshots
+cover. On open(), snapshots are mapped into memory and turned into graphs in parallel,
+and the journal written after them is replayed, so a restart costs about as much as
+reading the snapshots back, however many edits built the graphs. Private graphs and
+computed MSTs belong to one connection and are not kept.
+
+A snapshot file (graph-<hex of the name>.snap, within NAME_MAX since names are at most
+GraphRegistry::MAX_NAME bytes) is the graph's adjacency in CSR form, in
+host byte order: a header (magic, format, LSN of the last journal record it includes,
+adjacency entries, vertices, name length), the name padded to 8 bytes, u64 offsets[V + 1],
+u32 neighbours[entries] padded to 8 bytes, then f64 weights[entries]. It is written to a
+temporary file and renamed, so a crash leaves either the old snapshot or the new one.
+*/
+class GraphStore {
+public:
+    struct Options {
+        std::string directory;
+        unsigned snapshotSeconds = 300;           // Between checkpoints, when something changed
+        unsigned commitIntervalMs = 10;           // Longest a journal record nobody waits for stays buffered
+        uint64_t journalLimit = 1ull << 30;       // A checkpoint starts early at this segment size
+    };
+
+    explicit GraphStore(Options options, GraphRegistry& registry = GraphRegistry::shared());
+    // Stops checkpointing and commits the journal
+    ~GraphStore();
+
+    // Loads the snapshots, replays the journal, then journals every edit and starts the
+    // checkpoint thread; returns the number of graphs recovered
+    size_t open();
+    // Snapshots every graph changed since its last snapshot, then trims the journal
+    void checkpoint();
+    // Commits what the journal has buffered (at shutdown)
+    void commitNow();
+
+private:
+    bool writeSnapshot(const std::string& name, const SharedGraph::Snapshot& snapshot) const;
+    bool loadSnapshot(const std::string& path, std::string& name, std::shared_ptr<SharedGraph>& graph, uint64_t& lsn) const;
+    void replayJournal(std::unordered_map<std::string, uint64_t>& applied);
+    void checkpointLoop();
+    std::string snapshotPath(const std::string& name) const;
+
+    Options options_;
+    GraphRegistry& registry_;
+    std::unique_ptr<Journal> journal_;
+    std::mutex checkpointMutex_;
+    std::unordered_map<std::string, uint64_t> persisted_;  // LSN of each graph's snapshot on disk
+
+    std::mutex stopMutex_;
+    std::condition_variable stopCondition_;
+    bool stop_ = false;
+    std::thread checkpointer_;
+};
+
+#endif // GRAPHSTORE_HPP
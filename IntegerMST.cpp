@@ -1,4 +1,5 @@
 #include "IntegerMST.hpp"
+#include "Trace.hpp"
 #include <algorithm> // For std::sort
 #include <queue>     // For priority_queue
 #include <vector>    // For vector
@@ -46,6 +47,7 @@ void IntegerMST::Union(std::vector<size_t>& parent, std::vector<size_t>& rank, s
 
 // Main function to compute the MST using a priority queue and adjacency list (similar to Prim's algorithm)
 Tree IntegerMST::computeMST(const Graph& graph) {
+    TRACE_SPAN("integer");
     size_t V = (size_t)graph.getVertices();
     Tree mst(V); // Initialize an empty Tree for MST
     std::priority_queue<IntegerEdge, std::vector<IntegerEdge>, CompareIntegerEdge> pq; // Min-heap for edges
@@ -64,27 +66,32 @@ Tree IntegerMST::computeMST(const Graph& graph) {
 
     int mst_weight = 0;
 
-    while (!pq.empty()) {
-        IntegerEdge edge = pq.top();
-        pq.pop();
+    {
+        TRACE_SPAN("integer.grow");  // Heap operations, union-find and Tree::addEdge
+        while (!pq.empty()) {
+            IntegerEdge edge = pq.top();
+            pq.pop();
 
-        size_t u = find(parent, edge.src);
-        size_t v = find(parent, edge.dest);
+            size_t u = find(parent, edge.src);
+            size_t v = find(parent, edge.dest);
 
-        // If u and v are in different sets, include the edge in the MST
-        if (u != v) {
-            mst.addEdge(edge.src, edge.dest, edge.weight);
-            mst_weight += edge.weight;
-            Union(parent, rank, u, v);
+            // If u and v are in different sets, include the edge in the MST
+            if (u != v) {
+                mst.addEdge(edge.src, edge.dest, edge.weight);
+                mst_weight += edge.weight;
+                Union(parent, rank, u, v);
 
-            // Add all adjacent edges of the new node to the priority queue
-            for (const auto& neighbor : graph.getAdjList(edge.dest)) {
-                if (!inMST[(size_t)neighbor.first]) {
-                    pq.push(IntegerEdge(edge.dest, (size_t)neighbor.first, (size_t)neighbor.second));
+                // Add all adjacent edges of the new node to the priority queue
+                for (const auto& neighbor : graph.getAdjList(edge.dest)) {
+                    if (!inMST[(size_t)neighbor.first]) {
+                        pq.push(IntegerEdge(edge.dest, (size_t)neighbor.first, (size_t)neighbor.second));
+                    }
                 }
             }
         }
     }
 
+    mst.finalize();  // Pack into the CSR layout before the tree is shared
+
     return mst;
 }
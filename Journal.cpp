@@ -0,0 +1,331 @@
+#include "Journal.hpp"
+#include "Logger.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+
+const char SEGMENT_PREFIX[] = "journal-";
+const char SEGMENT_SUFFIX[] = ".log";
+const size_t BODY_FIXED = 11;  // LSN, type and name length
+
+// CRC-32 (IEEE 802.3, reflected)
+uint32_t crc32(const char* data, size_t size) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> entries{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            entries[i] = c;
+        }
+        return entries;
+    }();
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+void putLittle(std::string& out, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+void patchLittle(char* at, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i) {
+        at[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+uint64_t getLittle(const char* at, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; ++i) {
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(at[i])) << (8 * i);
+    }
+    return value;
+}
+
+// Makes a new or removed directory entry durable
+void syncDirectory(const std::string& directory) {
+    int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd != -1) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+} // namespace
+
+Journal::Journal(std::string directory, uint64_t nextLsn, unsigned commitIntervalMs)
+    : directory_(std::move(directory)), commitIntervalMs_(std::max(1u, commitIntervalMs)), nextLsn_(nextLsn),
+      settledLsn_(nextLsn - 1) {
+    openSegment(nextLsn);
+    committer_ = std::thread(&Journal::committerLoop, this);
+}
+
+Journal::~Journal() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    committer_.join();
+    commit();
+    if (fd_ != -1) {
+        close(fd_);
+    }
+}
+
+size_t Journal::beginRecord(Record type, std::string_view graph) {
+    size_t start = pending_.size();
+    pending_.append(HEADER_SIZE, '\0');  // Length and CRC, set once the payload is in
+    putLittle(pending_, nextLsn_++, 8);
+    pending_.push_back(static_cast<char>(type));
+    putLittle(pending_, graph.size(), 2);
+    pending_.append(graph.data(), graph.size());
+    return start;
+}
+
+uint64_t Journal::finishRecord(size_t start) {
+    patchLittle(&pending_[start], pending_.size() - start - HEADER_SIZE, 4);
+    pendingRecords_.push_back(start);  // The committer computes the CRC, off the writers' path
+    if (pending_.size() >= COMMIT_BATCH) {
+        wake_.notify_one();
+    }
+    return nextLsn_ - 1;
+}
+
+void Journal::committerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+        // Someone waiting for a pending record, or a full batch, cuts the interval short
+        wake_.wait_for(lock, std::chrono::milliseconds(commitIntervalMs_), [this] {
+            return stop_ || (!pending_.empty() && (waiters_ > 0 || pending_.size() >= COMMIT_BATCH));
+        });
+        if (pending_.empty()) {
+            continue;
+        }
+        lock.unlock();
+        commit();
+        lock.lock();
+    }
+}
+
+void Journal::commit() {
+    std::lock_guard<std::mutex> file(fileMutex_);
+    uint64_t next;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        next = takePending();
+    }
+    drained_.notify_all();
+    writeOut(next - 1);
+}
+
+void Journal::waitDurable(uint64_t lsn) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (settledLsn_ < lsn) {
+        ++waiters_;
+        wake_.notify_one();
+        settled_.wait(lock, [this, lsn] { return settledLsn_ >= lsn; });
+        --waiters_;
+    }
+    if (lost(lsn)) {
+        throw std::runtime_error("Journal write failed: the edit is applied but not persisted");
+    }
+}
+
+void Journal::checkWritable() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (failed_) {
+        throw std::runtime_error("Journal write failed: edits are refused until the next checkpoint");
+    }
+}
+
+bool Journal::lost(uint64_t lsn) const {
+    for (const auto& range : lost_) {
+        if (lsn >= range.first && lsn <= range.second) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t Journal::takePending() {
+    writing_.swap(pending_);
+    writingRecords_.swap(pendingRecords_);
+    pending_.clear();
+    pendingRecords_.clear();
+    return nextLsn_;
+}
+
+void Journal::writeOut(uint64_t through) {
+    if (writing_.empty()) {
+        return;
+    }
+    for (size_t start : writingRecords_) {
+        size_t length = getLittle(&writing_[start], 4);
+        patchLittle(&writing_[start + 4], crc32(&writing_[start + HEADER_SIZE], length), 4);
+    }
+    bool failed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        failed = failed_;
+    }
+    const char* data = writing_.data();
+    size_t left = writing_.size();
+    while (!failed && left > 0) {
+        ssize_t written = write(fd_, data, left);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        failed = written < 0;
+        if (!failed) {
+            data += written;
+            left -= (size_t)written;
+        }
+    }
+    failed = failed || fdatasync(fd_) != 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (failed) {
+            // A partial record ends the segment for recovery: drop everything until the next one,
+            // and tell the waiters of these records that their edits are not persisted
+            if (!failed_) {
+                LOG(ERROR) << "Journal: write failed (" << std::strerror(errno) << "), edits are refused until the next checkpoint";
+            }
+            failed_ = true;
+            if (!lost_.empty() && lost_.back().second == settledLsn_) {
+                lost_.back().second = through;
+            } else {
+                lost_.emplace_back(settledLsn_ + 1, through);
+            }
+        }
+        settledLsn_ = through;
+    }
+    settled_.notify_all();
+    segmentBytes_.fetch_add(writing_.size() - left, std::memory_order_relaxed);
+    writing_.clear();
+    writingRecords_.clear();
+}
+
+uint64_t Journal::rotate() {
+    std::lock_guard<std::mutex> file(fileMutex_);
+    uint64_t first;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        first = takePending();  // Everything below first goes to the old segment
+    }
+    drained_.notify_all();
+    writeOut(first - 1);
+    close(fd_);
+    openSegment(first);
+    return first;
+}
+
+void Journal::openSegment(uint64_t firstLsn) {
+    char name[64];
+    std::snprintf(name, sizeof name, "%s%016llx%s", SEGMENT_PREFIX, (unsigned long long)firstLsn, SEGMENT_SUFFIX);
+    std::string path = directory_ + "/" + name;
+    fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    segmentLsn_ = firstLsn;
+    segmentBytes_.store(0, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mutex_);
+    failed_ = fd_ == -1;
+    if (failed_) {
+        LOG(ERROR) << "Journal: cannot open " << path << ": " << std::strerror(errno);
+        return;
+    }
+    syncDirectory(directory_);
+}
+
+void Journal::removeSegmentsBefore(uint64_t lsn) {
+    std::vector<std::pair<uint64_t, std::string>> files = segments(directory_);
+    bool removed = false;
+    // A segment ends where the next one starts
+    for (size_t i = 0; i + 1 < files.size() && files[i + 1].first <= lsn; ++i) {
+        removed = unlink(files[i].second.c_str()) == 0 || removed;
+    }
+    if (removed) {
+        syncDirectory(directory_);
+    }
+}
+
+uint64_t Journal::segmentBytes() const {
+    return segmentBytes_.load(std::memory_order_relaxed);
+}
+
+std::vector<std::pair<uint64_t, std::string>> Journal::segments(const std::string& directory) {
+    std::vector<std::pair<uint64_t, std::string>> files;
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr) {
+        return files;
+    }
+    const size_t prefix = sizeof SEGMENT_PREFIX - 1, suffix = sizeof SEGMENT_SUFFIX - 1;
+    while (struct dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.size() != prefix + 16 + suffix || name.compare(0, prefix, SEGMENT_PREFIX) != 0 ||
+            name.compare(prefix + 16, suffix, SEGMENT_SUFFIX) != 0) {
+            continue;
+        }
+        files.emplace_back(std::stoull(name.substr(prefix, 16), nullptr, 16), directory + "/" + name);
+    }
+    closedir(dir);
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+uint64_t Journal::replay(const std::string& directory, const Visitor& visit) {
+    uint64_t last = 0;
+    for (const auto& segment : segments(directory)) {
+        int fd = open(segment.second.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat info;
+        if (fd == -1 || fstat(fd, &info) != 0 || info.st_size == 0) {
+            if (fd != -1) {
+                close(fd);
+            }
+            continue;
+        }
+        size_t size = (size_t)info.st_size;
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            LOG(ERROR) << "Journal: cannot map " << segment.second << ": " << std::strerror(errno);
+            continue;
+        }
+        madvise(mapped, size, MADV_SEQUENTIAL);
+        const char* data = static_cast<const char*>(mapped);
+        size_t at = 0;
+        while (at + HEADER_SIZE + BODY_FIXED <= size) {
+            size_t length = getLittle(data + at, 4);
+            const char* body = data + at + HEADER_SIZE;
+            if (length < BODY_FIXED || length > size - at - HEADER_SIZE || getLittle(data + at + 4, 4) != crc32(body, length)) {
+                LOG(WARN) << "Journal: " << segment.second << " ends with " << (size - at) << " unreadable bytes";
+                break;
+            }
+            size_t nameLength = getLittle(body + 9, 2);
+            if (BODY_FIXED + nameLength > length) {
+                break;
+            }
+            last = getLittle(body, 8);
+            visit(last, static_cast<Record>(body[8]), std::string_view(body + BODY_FIXED, nameLength),
+                  std::string_view(body + BODY_FIXED + nameLength, length - BODY_FIXED - nameLength));
+            at += HEADER_SIZE + length;
+        }
+        munmap(mapped, size);
+    }
+    return last;
+}
@@ -0,0 +1,121 @@
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+
+/* Append-only log of the edits made to persistent graphs since their last snapshot.
+Appending only copies the record into a memory buffer; an edit is acknowledged once
+waitDurable() has seen its record on disk. A committer thread writes everything buffered
+with one write() and one fdatasync() as soon as someone waits (group commit): the edits
+appended during one flush share the next, so a flood of small edits costs one disk flush
+per batch, not one per edit. Records nobody waits for go out every commit interval. The log is a
+series of segment files named after their first record's LSN (log sequence number);
+a checkpoint starts a new segment, snapshots the graphs, then deletes the old segments.
+
+Record: u32 body length, u32 CRC-32 of the body, then the body: u64 LSN, u8 type,
+u16 graph name length, the name, and the payload of the WireProtocol frame of the same
+edit (little-endian). Recovery stops reading a segment at its first torn or corrupt record.
+*/
+class Journal {
+public:
+    enum class Record : uint8_t {
+        CREATE = 1,        // u32 vertices: creates the graph, or empties an existing one
+        ADD_EDGES = 2,     // u32 count, then count x (u32 u, u32 v, f64 weight)
+        REMOVE_EDGES = 3,  // u32 count, then count x (u32 u, u32 v)
+    };
+
+    // (lsn, type, graph name, payload) of one record found by replay()
+    using Visitor = std::function<void(uint64_t, Record, std::string_view, std::string_view)>;
+
+    // Starts a new segment in directory whose first record gets nextLsn
+    Journal(std::string directory, uint64_t nextLsn, unsigned commitIntervalMs);
+    // Commits every record appended so far
+    ~Journal();
+
+    /* Queues a record and returns its LSN; encode(std::string&) appends the payload.
+    LSNs follow the order of the calls, so callers that must keep their records in order
+    (the edits of one graph) call it under their own lock. Waits while the committer is
+    far behind, which slows writers down to the speed of the disk. The graph name must fit
+    its u16 length (GraphRegistry keeps names far shorter).
+    */
+    template <typename Encode>
+    uint64_t append(Record type, std::string_view graph, Encode&& encode) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        drained_.wait(lock, [this] { return pending_.size() < MAX_PENDING || failed_; });
+        size_t start = beginRecord(type, graph);
+        encode(pending_);
+        return finishRecord(start);
+    }
+
+    // Returns once the record lsn is on disk; throws std::runtime_error if writing it failed
+    void waitDurable(uint64_t lsn);
+    // Throws std::runtime_error while writes are failing: records appended now would be dropped
+    // (until rotate() opens the next segment)
+    void checkWritable() const;
+    // Returns once every record appended before the call is on disk
+    void commit();
+    // Starts a new segment and returns the LSN of its first record: the older segments hold
+    // only records below it
+    uint64_t rotate();
+    // Deletes the segments that only hold records below lsn
+    void removeSegmentsBefore(uint64_t lsn);
+    // Bytes written to the current segment
+    uint64_t segmentBytes() const;
+
+    // Calls visit for every intact record of the segments in directory, oldest first;
+    // returns the highest LSN seen (0 if none)
+    static uint64_t replay(const std::string& directory, const Visitor& visit);
+
+private:
+    static constexpr size_t MAX_PENDING = 256 << 20;  // Appenders wait beyond this backlog
+    static constexpr size_t COMMIT_BATCH = 4 << 20;   // Committed before the interval is up
+    static constexpr size_t HEADER_SIZE = 8;          // Length and CRC, before the body
+
+    size_t beginRecord(Record type, std::string_view graph);
+    uint64_t finishRecord(size_t start);
+    void committerLoop();
+    // Moves the pending records to writing_ and returns the LSN the next record will get;
+    // the caller holds both mutexes
+    uint64_t takePending();
+    // Seals and writes writing_, then syncs and settles the records up to through (the last
+    // LSN in writing_); the caller holds fileMutex_
+    void writeOut(uint64_t through);
+    bool lost(uint64_t lsn) const;  // The caller holds mutex_
+    void openSegment(uint64_t firstLsn);
+    static std::vector<std::pair<uint64_t, std::string>> segments(const std::string& directory);
+
+    std::string directory_;
+    unsigned commitIntervalMs_;
+
+    std::mutex fileMutex_;     // Held while writing, syncing or switching segments
+    int fd_ = -1;
+    uint64_t segmentLsn_ = 0;  // First LSN of the current segment
+    std::atomic<uint64_t> segmentBytes_{0};
+    std::string writing_;      // Records being written, swapped with pending_
+    std::vector<size_t> writingRecords_;
+
+    mutable std::mutex mutex_;  // Guards what appenders touch
+    std::condition_variable wake_;
+    std::condition_variable drained_;
+    std::condition_variable settled_;     // settledLsn_ moved
+    std::string pending_;
+    std::vector<size_t> pendingRecords_;  // Offsets of the records in pending_, CRC still unset
+    uint64_t nextLsn_;
+    uint64_t settledLsn_;                 // Records up to here are on disk or were dropped
+    size_t waiters_ = 0;                  // Threads in waitDurable()
+    std::vector<std::pair<uint64_t, uint64_t>> lost_;  // Dropped LSN ranges, one per failure
+    bool stop_ = false;
+    bool failed_ = false;      // A write failed: records are dropped rather than block forever
+    std::thread committer_;
+};
+
+#endif // JOURNAL_HPP
@@ -1,4 +1,5 @@
 #include "KruskalMST.hpp"
+#include "Trace.hpp"
 #include <algorithm>
 #include <vector>
 #include <numeric>
@@ -42,22 +43,33 @@ void Union(Subset subsets[], int x, int y) {
 }
 
 Tree KruskalMST::computeMST(const Graph& graph) {
+    return computeMST(graph, nullptr);
+}
+
+Tree KruskalMST::computeMST(const Graph& graph, KruskalReconstructionTree* reconstruction) {
+    TRACE_SPAN("kruskal");
     int V = graph.getVertices();
     vector<Edge> edges;
 
     // Convert adjacency list to edge list
-    for (size_t u = 0; u < static_cast<size_t>(V); ++u) {
-        for (const auto& neighbor : graph.getAdjList(static_cast<size_t>(u))) {
-            if (static_cast<size_t>(u) < (size_t)neighbor.first) {
-                edges.push_back({static_cast<int>(u), neighbor.first, neighbor.second});
+    {
+        TRACE_SPAN("kruskal.extract_edges");
+        for (size_t u = 0; u < static_cast<size_t>(V); ++u) {
+            for (const auto& neighbor : graph.getAdjList(static_cast<size_t>(u))) {
+                if (static_cast<size_t>(u) < (size_t)neighbor.first) {
+                    edges.push_back({static_cast<int>(u), neighbor.first, neighbor.second});
+                }
             }
         }
     }
 
     // Sort edges in increasing order on basis of cost
-    sort(edges.begin(), edges.end(), [](Edge a, Edge b) {
-        return a.weight < b.weight;
-    });
+    {
+        TRACE_SPAN("kruskal.sort");
+        sort(edges.begin(), edges.end(), [](Edge a, Edge b) {
+            return a.weight < b.weight;
+        });
+    }
 
     // Allocate memory for creating V subsets
     Subset* subsets = new Subset[V];
@@ -68,17 +80,39 @@ Tree KruskalMST::computeMST(const Graph& graph) {
 
     Tree mst(V);
 
-    for (const Edge& edge : edges) {
-        int x = find(subsets, edge.src);
-        int y = find(subsets, edge.dest);
+    // Reconstruction tree node currently spanning each union-find root
+    vector<size_t> reconstructionNode;
+    if (reconstruction) {
+        reconstruction->reset((size_t)V);
+        reconstructionNode.resize((size_t)V);
+        iota(reconstructionNode.begin(), reconstructionNode.end(), 0);
+    }
+
+    {
+        TRACE_SPAN("kruskal.union_find");  // Includes Tree::addEdge, which only appends
+        for (const Edge& edge : edges) {
+            int x = find(subsets, edge.src);
+            int y = find(subsets, edge.dest);
 
-        if (x != y) {
-            mst.addEdge((size_t)edge.src, (size_t)edge.dest, edge.weight);
-            Union(subsets, x, y);
+            if (x != y) {
+                mst.addEdge((size_t)edge.src, (size_t)edge.dest, edge.weight);
+                Union(subsets, x, y);
+                if (reconstruction) {
+                    size_t node = reconstruction->merge(reconstructionNode[(size_t)x], reconstructionNode[(size_t)y], edge.weight);
+                    reconstructionNode[(size_t)find(subsets, x)] = node;
+                }
+            }
         }
     }
 
+    if (reconstruction) {
+        TRACE_SPAN("kruskal.reconstruction_index");
+        reconstruction->buildIndex();
+    }
+
     delete[] subsets;  // Clean up allocated memory if needed
 
+    mst.finalize();  // Pack into the CSR layout before the tree is shared
+
     return mst;  // Ensure to return a Tree object
 }
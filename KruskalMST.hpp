@@ -2,10 +2,13 @@
 #define KRUSKALMST_HPP
 
 #include "MSTStrategy.hpp"
+#include "ReconstructionTree.hpp"
 
 class KruskalMST : public MSTStrategy {
 public:
     Tree computeMST(const Graph& graph) override;
+    // Same MST; also records every union into reconstruction (may be null) and indexes it
+    Tree computeMST(const Graph& graph, KruskalReconstructionTree* reconstruction);
 };
 
 #endif // KRUSKALMST_HPP
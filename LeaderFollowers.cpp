@@ -0,0 +1,122 @@
+#include "LeaderFollowers.hpp"
+#include "CpuTopology.hpp"
+#include "Stats.hpp"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <system_error>
+
+LeaderFollowersPool::LeaderFollowersPool(size_t threadCount, EventHandler onEvent, CloseHandler onClose, const std::vector<int>& cpus)
+    : onEvent(std::move(onEvent)), onClose(std::move(onClose)),
+      queueWait(Stats::histogram("queue_wait_seconds", "queue=\"leader_followers\"")) {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd == -1) {
+        throw std::system_error(errno, std::generic_category(), "epoll_create1");
+    }
+    wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wakeFd == -1) {
+        close(epollFd);
+        throw std::system_error(errno, std::generic_category(), "eventfd");
+    }
+    // The wake handle is level triggered so every leader sees it once stopping is set
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+
+    for (size_t i = 0; i < threadCount; ++i) {
+        int cpu = i < cpus.size() ? cpus[i] : -1;
+        threads.emplace_back([this, cpu]() {
+            if (cpu >= 0) {
+                pinCurrentThread(cpu);
+            }
+            followerLoop();
+        });
+    }
+}
+
+LeaderFollowersPool::~LeaderFollowersPool() {
+    stop();
+    join();
+    close(wakeFd);
+    close(epollFd);
+}
+
+void LeaderFollowersPool::addHandle(int fd) {
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    ev.data.fd = fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        throw std::system_error(errno, std::generic_category(), "epoll_ctl add");
+    }
+}
+
+void LeaderFollowersPool::rearm(int fd) {
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    ev.data.fd = fd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+void LeaderFollowersPool::join() {
+    for (auto& thread : threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+void LeaderFollowersPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(leaderMutex);
+        stopping = true;
+    }
+    uint64_t one = 1;
+    ssize_t written = write(wakeFd, &one, sizeof(one));
+    (void)written;
+    followers.notify_all();
+}
+
+void LeaderFollowersPool::followerLoop() {
+    while (true) {
+        // Follow until there is no leader, then take over
+        {
+            std::unique_lock<std::mutex> lock(leaderMutex);
+            followers.wait(lock, [this] { return stopping || !leaderActive; });
+            if (stopping) {
+                return;
+            }
+            leaderActive = true;
+        }
+
+        epoll_event ev{};
+        int ready;
+        do {
+            ready = epoll_wait(epollFd, &ev, 1, -1);
+        } while (ready == -1 && errno == EINTR);
+        uint64_t woken = Stats::now();
+
+        // Promote a follower before processing, so the set is watched again right away
+        {
+            std::lock_guard<std::mutex> lock(leaderMutex);
+            leaderActive = false;
+        }
+        followers.notify_one();
+
+        if (ready != 1 || ev.data.fd == wakeFd) {
+            continue;  // The next wait sees stopping and returns
+        }
+
+        int fd = ev.data.fd;
+        Stats::record(queueWait, Stats::now() - woken);
+        bool keep = !(ev.events & (EPOLLERR | EPOLLHUP)) && onEvent(fd);
+        if (keep) {
+            rearm(fd);  // Return the handle to the set
+        } else {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+            onClose(fd);
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef LEADERFOLLOWERS_HPP
+#define LEADERFOLLOWERS_HPP
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "Stats.hpp"
+
+/* Leader/Followers event demultiplexing.
+All handles live in one epoll set and are registered one-shot. At any time a single
+leader thread blocks in epoll_wait; the other threads wait as followers. When an event
+arrives the leader promotes a follower to be the next leader and then processes that one
+event itself, so there is no queue handoff between I/O and processing. Because handles
+are one-shot, the handle being processed cannot be reported to another thread until it
+is returned to the set (re-armed) afterwards.
+*/
+class LeaderFollowersPool {
+public:
+    // Processes one ready event on fd; returning false removes fd from the set
+    using EventHandler = std::function<bool(int fd)>;
+    // Called after fd has been removed from the set
+    using CloseHandler = std::function<void(int fd)>;
+
+    // Thread i is pinned to cpus[i] when cpus is not empty
+    LeaderFollowersPool(size_t threadCount, EventHandler onEvent, CloseHandler onClose, const std::vector<int>& cpus = {});
+    ~LeaderFollowersPool();
+
+    // Adds a handle to the set; it is reported at most once until it is re-armed
+    void addHandle(int fd);
+    // Blocks until the pool is stopped
+    void join();
+    void stop();
+
+private:
+    void followerLoop();
+    void rearm(int fd);
+
+    int epollFd;
+    int wakeFd;  // eventfd used to wake the leader on shutdown
+    EventHandler onEvent;
+    CloseHandler onClose;
+    Stats::Id queueWait;  // From the leader's epoll_wait returning until it starts on the event
+
+    std::mutex leaderMutex;
+    std::condition_variable followers;
+    bool leaderActive = false;
+    bool stopping = false;
+    std::vector<std::thread> threads;
+};
+
+#endif // LEADERFOLLOWERS_HPP
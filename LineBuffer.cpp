@@ -0,0 +1,129 @@
+#include "LineBuffer.hpp"
+#include <cstring>
+#include <algorithm>
+
+namespace {
+
+const size_t MIN_CAPACITY = 4096;
+const size_t KEEP_CAPACITY = 1 << 20;  // Larger buffers are freed when they drain
+
+uint32_t frameLength(const char* header) {
+    uint32_t length = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        length |= static_cast<uint32_t>(static_cast<unsigned char>(header[i])) << (8 * i);
+    }
+    return length;
+}
+
+} // namespace
+
+char* LineBuffer::prepare(size_t min) {
+    if (writable() >= min) {
+        return data_.data() + end_;
+    }
+    // Slide the unconsumed bytes to the front first; grow only if that is not enough
+    if (begin_ > 0) {
+        std::memmove(data_.data(), data_.data() + begin_, end_ - begin_);
+        complete_ -= begin_;
+        scanned_ -= begin_;
+        end_ -= begin_;
+        begin_ = 0;
+    }
+    if (writable() < min) {
+        size_t capacity = std::max(data_.size() * 2, MIN_CAPACITY);
+        while (capacity - end_ < min) {
+            capacity *= 2;
+        }
+        data_.resize(capacity);
+    }
+    return data_.data() + end_;
+}
+
+void LineBuffer::commit(size_t n) {
+    end_ += n;
+    const char* base = data_.data();
+    if (framed_) {
+        // Headers say where each frame ends, so only complete_ moves and payloads are never scanned
+        while (end_ - complete_ >= FRAME_HEADER) {
+            size_t size = FRAME_HEADER + frameLength(base + complete_);
+            if (end_ - complete_ < size) {
+                break;
+            }
+            complete_ += size;
+            ++lines_;
+        }
+        scanned_ = end_;
+        return;
+    }
+    while (scanned_ < end_) {
+        const void* newline = std::memchr(base + scanned_, '\n', end_ - scanned_);
+        if (newline == nullptr) {
+            scanned_ = end_;
+            break;
+        }
+        scanned_ = static_cast<size_t>(static_cast<const char*>(newline) - base) + 1;
+        complete_ = scanned_;
+        ++lines_;
+    }
+}
+
+void LineBuffer::consumeLines() {
+    begin_ = complete_;
+    lines_ = 0;
+    if (begin_ == end_) {
+        begin_ = complete_ = scanned_ = end_ = 0;  // Nothing partial left: restart at the front for free
+        if (data_.size() > KEEP_CAPACITY) {
+            std::vector<char>().swap(data_);
+        }
+    }
+}
+
+size_t LineBuffer::partialSize() const {
+    size_t partial = end_ - complete_;
+    if (framed_ && partial >= FRAME_HEADER) {
+        return FRAME_HEADER + frameLength(data_.data() + complete_);
+    }
+    return partial;
+}
+
+void LineBuffer::useFrames(size_t skip) {
+    framed_ = true;
+    begin_ = complete_ = scanned_ = std::min(begin_ + skip, end_);
+    lines_ = 0;
+    commit(0);  // Frames that arrived together with the skipped bytes
+}
+
+void LineBuffer::clear() {
+    begin_ = complete_ = scanned_ = end_ = 0;
+    lines_ = 0;
+}
+
+bool LineBuffer::nextLine(std::string_view& text, std::string_view& line) {
+    while (!text.empty()) {
+        size_t newline = text.find('\n');
+        size_t length = newline == std::string_view::npos ? text.size() : newline;
+        line = text.substr(0, length);
+        text.remove_prefix(newline == std::string_view::npos ? text.size() : newline + 1);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (!line.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LineBuffer::nextFrame(std::string_view& text, uint8_t& type, std::string_view& payload) {
+    if (text.size() < FRAME_HEADER) {
+        return false;
+    }
+    size_t length = frameLength(text.data());
+    if (text.size() - FRAME_HEADER < length) {
+        return false;
+    }
+    type = static_cast<uint8_t>(text[4]);
+    payload = text.substr(FRAME_HEADER, length);
+    text.remove_prefix(FRAME_HEADER + length);
+    return true;
+}
@@ -0,0 +1,61 @@
+#ifndef LINEBUFFER_HPP
+#define LINEBUFFER_HPP
+
+#include <vector>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+/* Per-connection input buffer with an incremental line splitter.
+The socket reads straight into prepare()'s free space, so bytes are never staged in a
+temporary buffer. Every commit() scans only the new bytes for '\n' (memchr), so a long line
+arriving in many pieces is scanned once in total. Complete lines are exposed as one
+contiguous view over the buffer and split with nextLine() without copying; the consumed
+prefix is reclaimed by sliding the (usually short) partial tail to the front when it would
+otherwise have to grow, and the storage is released once an oversized buffer drains.
+After useFrames() the same buffer splits length-prefixed binary frames (u32 little-endian
+payload length, u8 type, payload) instead: the "lines" are then whole frames, taken apart
+with nextFrame().
+*/
+class LineBuffer {
+public:
+    static const size_t FRAME_HEADER = 5;  // u32 length + u8 type
+
+    LineBuffer() = default;  // Allocates on the first prepare(), so idle connections cost nothing
+
+    // At least min writable bytes at the end of the data; commit(n) after writing n of them
+    char* prepare(size_t min);
+    size_t writable() const { return data_.size() - end_; }
+    void commit(size_t n);
+
+    // All complete lines (each ending in '\n'), valid until the next prepare() or consume
+    std::string_view completeLines() const { return std::string_view(data_.data() + begin_, complete_ - begin_); }
+    size_t lineCount() const { return lines_; }
+    void consumeLines();                               // Drops everything completeLines() returned
+    // Bytes of the unfinished last line; for frames, the announced size once its header arrived
+    size_t partialSize() const;
+    bool empty() const { return begin_ == end_; }
+    void clear();
+
+    // Everything received and not consumed, complete or not
+    std::string_view unconsumed() const { return std::string_view(data_.data() + begin_, end_ - begin_); }
+    // Drops the first skip bytes and splits the rest into frames from now on
+    void useFrames(size_t skip);
+    bool framed() const { return framed_; }
+
+    // Splits the next non-empty line off the front of text, without "\n" / "\r\n"
+    static bool nextLine(std::string_view& text, std::string_view& line);
+    // Splits the next complete frame off the front of text
+    static bool nextFrame(std::string_view& text, uint8_t& type, std::string_view& payload);
+
+private:
+    std::vector<char> data_;
+    size_t begin_ = 0;     // First unconsumed byte
+    size_t complete_ = 0;  // One past the last '\n' (or complete frame) seen
+    size_t scanned_ = 0;   // Bytes already searched for '\n'
+    size_t end_ = 0;       // One past the last byte received
+    size_t lines_ = 0;     // Newlines (or frames) in [begin_, complete_)
+    bool framed_ = false;
+};
+
+#endif // LINEBUFFER_HPP
@@ -0,0 +1,191 @@
+#include "Logger.hpp"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <cerrno>
+#include <vector>
+#include <unistd.h>
+
+namespace {
+
+const char* const LEVEL_NAMES[] = {"DEBUG", "INFO ", "WARN ", "ERROR"};
+const char* const LEVEL_SPECS[] = {"debug", "info", "warn", "error", "off"};
+
+thread_local std::string lineBuffer;
+thread_local uint32_t threadIndex = 0;  // 0 until the thread logs for the first time
+thread_local unsigned sampleCounter = 0;
+
+void writeAll(int fd, const std::string& text) {
+    const char* data = text.data();
+    size_t left = text.size();
+    while (left > 0) {
+        ssize_t written = ::write(fd, data, left);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return;  // Nowhere to log to; the server keeps going
+        }
+        data += written;
+        left -= (size_t)written;
+    }
+}
+
+} // namespace
+
+Logger& Logger::shared() {
+    // Never destroyed: the servers exit from signal handlers, possibly on the writer thread
+    static Logger* logger = new Logger();
+    return *logger;
+}
+
+Logger::Logger() : ring_(RING_SIZE) {
+    writer_ = std::thread(&Logger::writerLoop, this);
+    writer_.detach();
+}
+
+void Logger::configure(Level minimum, unsigned sampleEvery) {
+    minimum_.store(static_cast<uint8_t>(minimum), std::memory_order_relaxed);
+    sampleEvery_.store(std::max(1u, sampleEvery), std::memory_order_relaxed);
+}
+
+bool Logger::configure(std::string_view spec) {
+    std::string_view name = spec.substr(0, spec.find(':'));
+    unsigned every = 1;
+    if (name.size() < spec.size()) {
+        std::string_view count = spec.substr(name.size() + 1);
+        auto result = std::from_chars(count.data(), count.data() + count.size(), every);
+        if (result.ec != std::errc() || result.ptr != count.data() + count.size() || every == 0) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < sizeof LEVEL_SPECS / sizeof LEVEL_SPECS[0]; ++i) {
+        if (name == LEVEL_SPECS[i]) {
+            configure(static_cast<Level>(i), every);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Logger::admit(Level level) {
+    if (static_cast<uint8_t>(level) < minimum_.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    if (level >= Level::WARN) {
+        return true;
+    }
+    unsigned every = sampleEvery_.load(std::memory_order_relaxed);
+    return every == 1 || sampleCounter++ % every == 0;
+}
+
+void Logger::write(Level level, std::string_view message) {
+    if (threadIndex == 0) {
+        threadIndex = threads_.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+    Record record;
+    record.micros = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    record.thread = threadIndex;
+    record.level = level;
+    record.length = (uint16_t)std::min(message.size(), TEXT_SIZE);
+    std::memcpy(record.text, message.data(), record.length);
+    if (message.size() > TEXT_SIZE) {
+        std::memcpy(record.text + TEXT_SIZE - 3, "...", 3);
+        truncated_.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!ring_.tryPush(record)) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Logger::flush() {
+    Record marker;
+    marker.sequence = flushRequested_.fetch_add(1, std::memory_order_relaxed) + 1;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (!ring_.tryPush(marker)) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    while (flushed_.load(std::memory_order_acquire) < marker.sequence && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void Logger::writerLoop() {
+    std::vector<Record> batch;
+    batch.reserve(WRITE_BATCH);
+    std::string out;
+    while (true) {
+        batch.clear();
+        ring_.popBatch(batch, WRITE_BATCH);
+        out.clear();
+        uint64_t marker = 0;
+        for (const Record& record : batch) {
+            if (record.sequence != 0) {
+                marker = std::max(marker, record.sequence);
+            } else {
+                format(record, out);
+            }
+        }
+        uint64_t dropped = dropped_.exchange(0, std::memory_order_relaxed);
+        if (dropped > 0) {
+            ReplyWriter(out) << "(logger: " << dropped << " records dropped, the log could not keep up)\n";
+        }
+        uint64_t truncated = truncated_.exchange(0, std::memory_order_relaxed);
+        if (truncated > 0) {
+            ReplyWriter(out) << "(logger: " << truncated << " records cut at " << TEXT_SIZE << " bytes)\n";
+        }
+        writeAll(STDOUT_FILENO, out);
+        if (marker != 0) {
+            flushed_.store(marker, std::memory_order_release);
+        }
+    }
+}
+
+void Logger::format(const Record& record, std::string& out) {
+    time_t seconds = (time_t)(record.micros / 1000000);
+    struct tm local;
+    localtime_r(&seconds, &local);
+    char stamp[32];
+    size_t length = strftime(stamp, sizeof stamp, "%Y-%m-%d %H:%M:%S", &local);
+    char micros[16];
+    std::snprintf(micros, sizeof micros, ".%06lld", (long long)(record.micros % 1000000));
+    ReplyWriter line(out);
+    line << std::string_view(stamp, length) << std::string_view(micros) << ' '
+         << LEVEL_NAMES[static_cast<size_t>(record.level)] << " [t" << record.thread << "] ";
+    // Keep the record on one line
+    std::string_view text(record.text, record.length);
+    for (size_t newline; (newline = text.find('\n')) != std::string_view::npos; text.remove_prefix(newline + 1)) {
+        line << text.substr(0, newline) << "\\n";
+    }
+    line << text << '\n';
+}
+
+LogLine::LogLine(Logger::Level level) : level_(level), text_(lineBuffer), writer_(lineBuffer) {
+    text_.clear();
+}
+
+LogLine::~LogLine() {
+    Logger::shared().write(level_, text_);
+}
+
+void LogLine::appendText(std::string_view value) {
+    if (!value.empty() && value.find_first_of(" \"=\\\n") == std::string_view::npos) {
+        writer_ << value;
+        return;
+    }
+    writer_ << '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            writer_ << '\\';
+        }
+        writer_ << c;
+    }
+    writer_ << '"';
+}
@@ -0,0 +1,123 @@
+#ifndef LOGGER_HPP
+#define LOGGER_HPP
+
+#include <string>
+#include <string_view>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+#include "BoundedQueue.hpp"
+#include "ReplyWriter.hpp"
+
+/* Asynchronous logger shared by both servers.
+A thread that logs formats its line into a fixed-size record and pushes it onto a
+lock-free BoundedQueue; a background writer turns whole batches of records into one
+write() to stdout. The request path therefore never waits for the terminal: when the
+ring is full the record is dropped and counted, and the writer reports the count.
+Records below WARN can be sampled (1 in N per thread) and records below the configured
+level are not even formatted, see LOG().
+
+One record is one line:
+
+    2026-10-19 05:02:12.123456 INFO  [t3] MST computed algorithm=prim vertices=1000 edges=999
+
+local time with microseconds, level, logging thread, a fixed message, then the
+LogField pairs as key=value. A value holding a space, '"', '=' or '\' is written in
+double quotes with '"' and '\' escaped, and newlines anywhere in a record are written
+as \n, so a line splits on spaces and '=' without knowing the message. A record keeps
+TEXT_SIZE bytes: a longer one ends in "..." and the writer reports how many were cut,
+so log sizes, not whole trees or graphs.
+*/
+class Logger {
+public:
+    enum class Level : uint8_t { DEBUG, INFO, WARN, ERROR, OFF };
+
+    static Logger& shared();
+
+    // Records below minimum are skipped; those below WARN are kept 1 in sampleEvery
+    void configure(Level minimum, unsigned sampleEvery = 1);
+    // "debug", "info", "warn", "error" or "off", optionally followed by ":N" for the sampling
+    bool configure(std::string_view spec);
+
+    // True if a record of this level is to be written; decides the sampling, so call it once per record
+    bool admit(Level level);
+    // Queues a record without blocking; longer messages are truncated
+    void write(Level level, std::string_view message);
+    // Waits (at most a second) until the records queued so far are written
+    void flush();
+
+private:
+    static constexpr size_t RING_SIZE = 8192;     // Records
+    static constexpr size_t TEXT_SIZE = 1000;     // Message bytes kept per record
+    static constexpr size_t WRITE_BATCH = 256;    // Records per write()
+
+    struct Record {
+        uint64_t sequence = 0;   // Nonzero: a flush marker, nothing to print
+        int64_t micros = 0;      // Wall clock, microseconds since the epoch
+        uint32_t thread = 0;
+        uint16_t length = 0;
+        Level level = Level::INFO;
+        char text[TEXT_SIZE];
+    };
+
+    Logger();
+    void writerLoop();
+    void format(const Record& record, std::string& out);
+
+    BoundedQueue<Record> ring_;
+    std::atomic<uint8_t> minimum_{static_cast<uint8_t>(Level::INFO)};
+    std::atomic<unsigned> sampleEvery_{1};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> truncated_{0};
+    std::atomic<uint64_t> flushRequested_{0};
+    std::atomic<uint64_t> flushed_{0};
+    std::atomic<uint32_t> threads_{0};
+    std::thread writer_;
+};
+
+// One key=value pair of a record: LOG(INFO) << "MST computed" << LogField("vertices", n);
+template <typename T>
+struct LogField {
+    LogField(std::string_view key, const T& value) : key(key), value(value) {}
+
+    std::string_view key;
+    const T& value;
+};
+
+// A record being formatted with ReplyWriter's operators; queued when it goes out of scope
+class LogLine {
+public:
+    explicit LogLine(Logger::Level level);
+    ~LogLine();
+
+    template <typename T>
+    LogLine& operator<<(const T& value) {
+        writer_ << value;
+        return *this;
+    }
+
+    template <typename T>
+    LogLine& operator<<(const LogField<T>& field) {
+        writer_ << ' ' << field.key << '=';
+        if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+            appendText(field.value);
+        } else {
+            writer_ << field.value;
+        }
+        return *this;
+    }
+
+private:
+    void appendText(std::string_view value);  // Quoted and escaped when it would not split cleanly
+
+    Logger::Level level_;
+    std::string& text_;  // Per-thread buffer, reused
+    ReplyWriter writer_;
+};
+
+// LOG(INFO) << "text " << value; -- the operands are only evaluated if the record is admitted
+#define LOG(level) \
+    if (!Logger::shared().admit(Logger::Level::level)) {} else LogLine(Logger::Level::level)
+
+#endif // LOGGER_HPP
@@ -22,3 +22,40 @@ std::unique_ptr<MSTStrategy> MSTFactory::createMSTStrategy(MSTFactory::Algorithm
             return nullptr;
     }
 }
+
+namespace {
+
+struct NamedAlgorithm {
+    const char* name;
+    MSTFactory::Algorithm algorithm;
+};
+
+// The one place an algorithm is given its protocol name
+const NamedAlgorithm ALGORITHMS[] = {
+    {"Kruskal", MSTFactory::Algorithm::KRUSKAL},
+    {"Prim", MSTFactory::Algorithm::PRIM},
+    {"Boruvka", MSTFactory::Algorithm::Boruvka},
+    {"Tarjan", MSTFactory::Algorithm::Tarjan},
+    {"Integer", MSTFactory::Algorithm::Integer},
+};
+
+} // namespace
+
+const char* MSTFactory::name(Algorithm algo) {
+    for (const NamedAlgorithm& entry : ALGORITHMS) {
+        if (entry.algorithm == algo) {
+            return entry.name;
+        }
+    }
+    return "Unknown";
+}
+
+bool MSTFactory::fromName(std::string_view name, Algorithm& algo) {
+    for (const NamedAlgorithm& entry : ALGORITHMS) {
+        if (name == entry.name) {
+            algo = entry.algorithm;
+            return true;
+        }
+    }
+    return false;
+}
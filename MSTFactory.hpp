@@ -3,6 +3,7 @@
 
 #include "MSTStrategy.hpp"
 #include <memory>
+#include <string_view>
 
 class MSTFactory {
 public:
@@ -15,6 +16,10 @@ public:
     };
 
     static std::unique_ptr<MSTStrategy> createMSTStrategy(Algorithm algo);
+
+    // The names clients use ("Kruskal", "Prim", "Boruvka", "Tarjan", "Integer")
+    static const char* name(Algorithm algo);
+    static bool fromName(std::string_view name, Algorithm& algo);  // false if unknown
 };
 
 #endif // MSTFACTORY_HPP
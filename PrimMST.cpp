@@ -1,4 +1,5 @@
 #include "PrimMST.hpp"
+#include "Trace.hpp"
 #include <queue>
 #include <vector>
 #include <limits>
@@ -17,6 +18,7 @@ struct CompareWeight {
 };
 
 Tree PrimMST::computeMST(const Graph& graph) {
+    TRACE_SPAN("prim");
     size_t V = (size_t)graph.getVertices();
     Tree mst(V); // Initialize an empty Tree for MST
     std::vector<bool> inMST(V, false); // To track vertices included in MST
@@ -31,35 +33,40 @@ Tree PrimMST::computeMST(const Graph& graph) {
         pq.push(Edge(startVertex, neighbor.first, neighbor.second));
     }
 
-    while (!pq.empty()) {
-        Edge e = pq.top();
-        pq.pop();
+    {
+        TRACE_SPAN("prim.grow");  // Heap operations and Tree::addEdge
+        while (!pq.empty()) {
+            Edge e = pq.top();
+            pq.pop();
 
-        size_t u = (size_t)e.src;
-        size_t v = (size_t)e.dest;
-        double weight = e.weight;
+            size_t u = (size_t)e.src;
+            size_t v = (size_t)e.dest;
+            double weight = e.weight;
 
-        // Check for cycle (ignore if both vertices are already in MST)
-        if (inMST[u] && inMST[v])
-            continue;
+            // Check for cycle (ignore if both vertices are already in MST)
+            if (inMST[u] && inMST[v])
+                continue;
 
-        // Add the current edge to MST
-        mst.addEdge(u, v, weight);
-        if (!inMST[u]) {
-            inMST[u] = true;
-            for (const auto& neighbor : graph.getAdjList(u)) {
-                if (!inMST[(size_t)neighbor.first])
-                    pq.push(Edge(u, neighbor.first, neighbor.second));
+            // Add the current edge to MST
+            mst.addEdge(u, v, weight);
+            if (!inMST[u]) {
+                inMST[u] = true;
+                for (const auto& neighbor : graph.getAdjList(u)) {
+                    if (!inMST[(size_t)neighbor.first])
+                        pq.push(Edge(u, neighbor.first, neighbor.second));
+                }
             }
-        }
-        if (!inMST[v]) {
-            inMST[v] = true;
-            for (const auto& neighbor : graph.getAdjList(v)) {
-                if (!inMST[(size_t)neighbor.first])
-                    pq.push(Edge(v, neighbor.first, neighbor.second));
+            if (!inMST[v]) {
+                inMST[v] = true;
+                for (const auto& neighbor : graph.getAdjList(v)) {
+                    if (!inMST[(size_t)neighbor.first])
+                        pq.push(Edge(v, neighbor.first, neighbor.second));
+                }
             }
         }
     }
 
+    mst.finalize();  // Pack into the CSR layout before the tree is shared
+
     return mst;
 }
@@ -0,0 +1,444 @@
+#include "Reactor.hpp"
+#include "WireProtocol.hpp"
+#include "Logger.hpp"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <system_error>
+#include <utility>
+
+namespace {
+
+const size_t READ_CHUNK = 16384;
+const size_t MAX_IOV = 64;           // Reply chunks gathered by one sendmsg
+const size_t COALESCE_BELOW = 4096;  // Short replies are appended to the previous chunk
+const size_t SPARE_LIMIT = 64 << 10;  // Larger reply buffers are freed rather than kept for reuse
+
+void setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+} // namespace
+
+const FrontEndStats& FrontEndStats::shared() {
+    static const FrontEndStats stats{
+        Stats::counter("bytes_received_total"),
+        Stats::counter("bytes_sent_total"),
+        Stats::gauge("connections_active"),
+        Stats::counter("connections_accepted_total"),
+        Stats::counter("connections_rejected_total"),
+        Stats::histogram("queue_wait_seconds", "queue=\"compute\""),
+        Stats::histogram("send_seconds"),
+    };
+    return stats;
+}
+
+Reactor::Reactor(int listenFd, WorkStealingPool& workers, OpenHandler onOpen, CommandHandler onCommand, CloseHandler onClose,
+                 DrainHandler onDrain, const AdmissionLimits& limits)
+    : listenFd(listenFd), workers(workers), onOpen(std::move(onOpen)), onCommand(std::move(onCommand)), onClose(std::move(onClose)),
+      onDrain(std::move(onDrain)), limits(limits) {
+    if (this->limits.maxInFlight == 0) {
+        this->limits.maxInFlight = 4 * workers.size();
+    }
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd == -1) {
+        throw std::system_error(errno, std::generic_category(), "epoll_create1");
+    }
+    wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wakeFd == -1) {
+        close(epollFd);
+        throw std::system_error(errno, std::generic_category(), "eventfd");
+    }
+
+    setNonBlocking(listenFd);
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+}
+
+Reactor::~Reactor() {
+    // Let running commands finish before their connections disappear: each one posts its
+    // completion and writes the eventfd, so sleep on it rather than spin
+    while (true) {
+        bool busy = false;
+        for (auto& entry : connections) {
+            busy = busy || entry.second->busy;
+        }
+        if (!busy) {
+            break;
+        }
+        pollfd completion{wakeFd, POLLIN, 0};
+        if (poll(&completion, 1, -1) == -1 && errno != EINTR) {
+            break;
+        }
+        uint64_t count;
+        while (read(wakeFd, &count, sizeof(count)) > 0) {
+        }
+        drainCompletions();
+    }
+    for (auto& entry : connections) {
+        onClose(entry.first);
+        close(entry.first);
+        Stats::add(FrontEndStats::shared().connectionsActive, -1);
+    }
+    close(wakeFd);
+    close(epollFd);
+}
+
+void Reactor::stop() {
+    stopping.store(true, std::memory_order_release);
+    wake();  // epoll_wait returns and run() sees the flag
+}
+
+void Reactor::post(int fd, std::string output, bool keep) {
+    {
+        std::lock_guard<std::mutex> lock(completionsMutex);
+        completions.push_back(Completion{fd, std::move(output), keep, true});
+    }
+    wake();
+}
+
+void Reactor::wake() {
+    uint64_t one = 1;
+    ssize_t written = write(wakeFd, &one, sizeof(one));
+    (void)written;
+}
+
+void Reactor::run() {
+    const int MAX_EVENTS = 256;
+    epoll_event events[MAX_EVENTS];
+    while (!stopping.load(std::memory_order_acquire)) {
+        int ready = epoll_wait(epollFd, events, MAX_EVENTS, -1);
+        if (ready == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "epoll_wait");
+        }
+        for (int i = 0; i < ready; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == listenFd) {
+                acceptAll();
+                continue;
+            }
+            if (fd == wakeFd) {
+                uint64_t count;
+                while (read(wakeFd, &count, sizeof(count)) > 0) {
+                }
+                drainCompletions();
+                continue;
+            }
+            auto it = connections.find(fd);
+            if (it == connections.end()) {
+                continue;
+            }
+            Connection& conn = *it->second;
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                conn.closing = true;
+                discard(conn);
+            } else {
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP)) {
+                    readAll(conn);
+                }
+                if (events[i].events & EPOLLOUT) {
+                    flush(conn);
+                }
+                resumeRead(conn);
+                dispatch(conn);
+            }
+            closeIfDone(conn);
+        }
+    }
+}
+
+void Reactor::acceptAll() {
+    while (true) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG(WARN) << "accept: " << std::strerror(errno);
+            }
+            return;
+        }
+        if (connections.size() >= limits.maxConnections) {
+            std::string reply = limits.busyReply();  // Best effort: the socket buffer is empty
+            ssize_t sent = send(fd, reply.data(), reply.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+            (void)sent;
+            close(fd);
+            Stats::add(FrontEndStats::shared().connectionsRejected);
+            continue;
+        }
+        Stats::add(FrontEndStats::shared().connectionsAccepted);
+        Stats::add(FrontEndStats::shared().connectionsActive);
+        auto conn = std::make_unique<Connection>();
+        conn->fd = fd;
+        conn->negotiated = !onFrame;  // Text only: nothing to detect
+        connections[fd] = std::move(conn);
+        onOpen(fd);
+
+        // Registered once for both directions; edge triggered, so only transitions are reported
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+// Reads until EAGAIN (required with edge triggering); the buffer finds the line ends as it goes
+void Reactor::readAll(Connection& conn) {
+    while (!conn.closing) {
+        if (!canRead(conn)) {
+            conn.readPaused = true;  // The rest stays in the socket; the peer sees a full window
+            return;
+        }
+        char* space = conn.input.prepare(READ_CHUNK);
+        ssize_t received = recv(conn.fd, space, conn.input.writable(), 0);
+        if (received > 0) {
+            conn.input.commit(static_cast<size_t>(received));
+            Stats::add(FrontEndStats::shared().bytesReceived, received);
+            if (!conn.negotiated) {
+                std::string hello;
+                conn.negotiated = WireProtocol::negotiate(conn.input, conn.binary, hello);
+                queueOutput(conn, std::move(hello));
+            }
+            if (conn.input.partialSize() > (conn.binary ? WireProtocol::MAX_FRAME : MAX_LINE)) {
+                queueOutput(conn, conn.binary ? WireProtocol::frameTooLarge() : std::string("Command too long\n"));
+                conn.closing = true;
+            }
+            continue;
+        }
+        if (received == 0) {
+            conn.closing = true;  // Peer finished sending; queued commands still run
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            conn.closing = true;
+            conn.input.clear();
+        }
+        return;
+    }
+}
+
+// Sends queued reply chunks, up to MAX_IOV of them per call
+void Reactor::flush(Connection& conn) {
+    while (!conn.output.empty()) {
+        iovec iov[MAX_IOV];
+        size_t count = 0;
+        for (auto it = conn.output.begin(); it != conn.output.end() && count < MAX_IOV; ++it, ++count) {
+            size_t skip = count == 0 ? conn.outputOffset : 0;
+            iov[count].iov_base = const_cast<char*>(it->data()) + skip;
+            iov[count].iov_len = it->size() - skip;
+        }
+        msghdr message{};
+        message.msg_iov = iov;
+        message.msg_iovlen = count;
+        uint64_t start = Stats::now();
+        ssize_t n = sendmsg(conn.fd, &message, MSG_NOSIGNAL);
+        Stats::record(FrontEndStats::shared().sendTime, Stats::now() - start);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                discard(conn);
+                conn.closing = true;
+            }
+            return;  // On EAGAIN, EPOLLOUT reports when there is room again
+        }
+        size_t sent = static_cast<size_t>(n);
+        Stats::add(FrontEndStats::shared().bytesSent, n);
+        conn.outputBytes -= sent;
+        while (sent > 0) {
+            size_t left = conn.output.front().size() - conn.outputOffset;
+            if (sent < left) {
+                conn.outputOffset += sent;
+                break;
+            }
+            sent -= left;
+            recycle(conn, std::move(conn.output.front()));
+            conn.output.pop_front();
+            conn.outputOffset = 0;
+        }
+    }
+}
+
+void Reactor::queueOutput(Connection& conn, std::string text) {
+    if (text.empty()) {
+        return;
+    }
+    conn.outputBytes += text.size();
+    if (!conn.output.empty() && conn.output.back().size() < COALESCE_BELOW && text.size() < COALESCE_BELOW) {
+        conn.output.back() += text;
+        recycle(conn, std::move(text));
+    } else {
+        conn.output.push_back(std::move(text));
+    }
+}
+
+// Drops everything still queued in either direction
+void Reactor::discard(Connection& conn) {
+    conn.input.clear();
+    conn.output.clear();
+    conn.outputOffset = 0;
+    conn.outputBytes = 0;
+}
+
+// Keeps the largest reasonably sized buffer seen, so steady traffic stops allocating replies
+void Reactor::recycle(Connection& conn, std::string&& buffer) {
+    if (buffer.capacity() > conn.spare.capacity() && buffer.capacity() <= SPARE_LIMIT) {
+        buffer.clear();
+        conn.spare = std::move(buffer);
+    }
+}
+
+bool Reactor::canRead(const Connection& conn) const {
+    return conn.input.lineCount() < limits.maxQueuedCommands && conn.outputBytes < limits.maxOutput;
+}
+
+// Picks up input left unread by backpressure once the connection has room again
+void Reactor::resumeRead(Connection& conn) {
+    if (conn.readPaused && canRead(conn)) {
+        conn.readPaused = false;
+        readAll(conn);
+    }
+}
+
+// Hands every complete line to a worker unless one is already running or the pool is full
+void Reactor::dispatch(Connection& conn) {
+    if (conn.busy || conn.waiting || conn.input.lineCount() == 0 || !conn.negotiated) {
+        return;
+    }
+    if (inFlight >= limits.maxInFlight) {
+        conn.waiting = true;
+        waitingForSlot.push_back(conn.fd);
+        return;
+    }
+    conn.busy = true;
+    ++inFlight;
+    std::string batch(conn.input.completeLines());  // One copy for the whole batch
+    conn.input.consumeLines();
+    int fd = conn.fd;
+    bool binary = conn.binary;
+    std::string output = std::move(conn.spare);  // Replies go straight into a reused buffer
+    conn.spare.clear();
+    uint64_t queued = Stats::now();
+    workers.submit([this, fd, binary, queued, batch = std::move(batch), output = std::move(output)]() mutable {
+        Stats::record(FrontEndStats::shared().computeQueueWait, Stats::now() - queued);
+        Completion done{fd, std::move(output), true};
+        done.keep = runBatch(fd, batch, binary, onCommand, onFrame, done.output);
+        {
+            std::lock_guard<std::mutex> lock(completionsMutex);
+            completions.push_back(std::move(done));
+        }
+        wake();
+    });
+}
+
+bool Reactor::runBatch(int fd, std::string_view batch, bool binary, const CommandHandler& onCommand,
+                       const FrameHandler& onFrame, std::string& out) {
+    bool keep = true;
+    if (binary) {
+        uint8_t type;
+        std::string_view payload;
+        while (keep && LineBuffer::nextFrame(batch, type, payload)) {
+            try {
+                keep = onFrame(fd, type, payload, out);
+            } catch (const std::exception& e) {
+                WireProtocol::appendError(out, type, e.what());
+            }
+        }
+        return keep;
+    }
+    std::string_view line;
+    std::string command;  // Reused, so short commands do not allocate
+    while (keep && LineBuffer::nextLine(batch, line)) {
+        command.assign(line.data(), line.size());
+        try {
+            keep = onCommand(fd, command, out);
+        } catch (const std::exception& e) {
+            out += std::string("Error: ") + e.what() + "\n";
+        }
+    }
+    return keep;
+}
+
+void Reactor::drainCompletions() {
+    std::vector<Completion> done;
+    {
+        std::lock_guard<std::mutex> lock(completionsMutex);
+        done.swap(completions);
+    }
+    for (Completion& completion : done) {
+        auto it = connections.find(completion.fd);
+        if (it == connections.end()) {
+            continue;
+        }
+        Connection& conn = *it->second;
+        if (completion.posted) {
+            conn.released = conn.released || !completion.keep;
+        } else {
+            conn.busy = false;
+            --inFlight;
+        }
+        queueOutput(conn, std::move(completion.output));
+        if (!completion.keep) {
+            conn.closing = true;
+            conn.input.clear();
+        }
+        flush(conn);
+        resumeRead(conn);
+        dispatch(conn);
+        closeIfDone(conn);
+    }
+
+    // Slots freed above go to the connections that have waited longest
+    while (inFlight < limits.maxInFlight && !waitingForSlot.empty()) {
+        auto it = connections.find(waitingForSlot.front());
+        waitingForSlot.pop_front();
+        if (it == connections.end() || !it->second->waiting) {
+            continue;
+        }
+        Connection& conn = *it->second;
+        conn.waiting = false;
+        dispatch(conn);
+        resumeRead(conn);
+        closeIfDone(conn);
+    }
+}
+
+void Reactor::closeIfDone(Connection& conn) {
+    if (!conn.closing || conn.busy || conn.input.lineCount() > 0) {
+        return;
+    }
+    if (onDrain && !conn.released) {
+        if (!conn.draining) {
+            conn.draining = true;
+            onDrain(conn.fd);
+        }
+        return;
+    }
+    if (!conn.output.empty()) {
+        return;
+    }
+    int fd = conn.fd;
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    connections.erase(fd);  // conn is destroyed here
+    onClose(fd);
+    close(fd);
+    Stats::add(FrontEndStats::shared().connectionsActive, -1);
+}
@@ -0,0 +1,153 @@
+#ifndef REACTOR_HPP
+#define REACTOR_HPP
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include "ThreadPool.hpp"
+#include "LineBuffer.hpp"
+#include "Stats.hpp"
+
+/* Edge-triggered epoll reactor.
+One thread owns every socket. Sockets are non-blocking, and each connection is a small
+state machine: bytes are read until EAGAIN straight into its LineBuffer, and whenever no
+worker is busy with the connection, every complete line received so far goes to the pool
+as one batch (so a session is only ever touched by one thread, commands run in order, and
+a client that pipelines thousands of lines costs one task and one wakeup per batch, not
+per line). Workers return the replies of the whole batch; the reactor queues reply chunks
+and writes them with one sendmsg (gathering writev-style), waiting for EPOLLOUT when the
+peer is slow. An idle connection is just an entry in the epoll set, it does not hold a thread.
+With a DrainHandler, replies may also be produced after onCommand returns (e.g. by a later
+pipeline stage) and handed over with post(). A connection that is done reading is then
+not closed by the reactor: it calls onDrain once, and closes after post(fd, ..., false).
+Backpressure (AdmissionLimits): a connection whose queued commands or unsent replies reach
+their bound is simply not read until they drain, so TCP flow control slows the client down;
+when the pool already holds maxInFlight commands, connections wait their turn in FIFO order
+instead of piling more tasks onto it.
+With a FrameHandler, a connection that opens with the WireProtocol hello is switched to
+binary frames instead of lines; batching, ordering and backpressure work the same way.
+*/
+// Bounds on what the server accepts before it pushes back on clients
+struct AdmissionLimits {
+    size_t maxConnections = 4096;      // Beyond this, new connections get busyReply() and are closed
+    size_t maxQueuedCommands = 64;     // Per connection: stop reading while this many lines wait
+    size_t maxOutput = 16 << 20;       // Per connection: stop reading while this many reply bytes wait
+    size_t maxInFlight = 0;            // Commands running or queued in the worker pool; 0 = 4 per worker
+    unsigned retryAfterMs = 100;
+
+    std::string busyReply() const {
+        return "Server busy, retry after " + std::to_string(retryAfterMs) + " ms\n";
+    }
+};
+
+// What every front end (Reactor, UringServer, Leader/Followers) records in Stats
+struct FrontEndStats {
+    Stats::Id bytesReceived;
+    Stats::Id bytesSent;
+    Stats::Id connectionsActive;
+    Stats::Id connectionsAccepted;
+    Stats::Id connectionsRejected;   // Turned away by maxConnections
+    Stats::Id computeQueueWait;      // From handing a batch to the pool until a worker starts it
+    Stats::Id sendTime;              // One send, from the call (or SQE) to its completion
+
+    static const FrontEndStats& shared();
+};
+
+class Reactor {
+public:
+    // A new connection was accepted
+    using OpenHandler = std::function<void(int fd)>;
+    // Runs one command on a worker; append the reply to out, return false to close afterwards
+    using CommandHandler = std::function<bool(int fd, const std::string& command, std::string& out)>;
+    // The connection is gone; no command of it is running
+    using CloseHandler = std::function<void(int fd)>;
+    // No more commands will run for fd; post(fd, ..., false) once its last output is posted
+    using DrainHandler = std::function<void(int fd)>;
+    // Runs one binary frame on a worker; append the whole reply frame to out, return false to close afterwards
+    using FrameHandler = std::function<bool(int fd, uint8_t type, std::string_view payload, std::string& out)>;
+
+    static const size_t MAX_LINE = 1 << 20;  // Longer lines are rejected and the connection closed
+
+    Reactor(int listenFd, WorkStealingPool& workers, OpenHandler onOpen, CommandHandler onCommand, CloseHandler onClose,
+            DrainHandler onDrain = nullptr, const AdmissionLimits& limits = AdmissionLimits());
+    ~Reactor();
+
+    // Runs the event loop on the calling thread until stop()
+    void run();
+    void stop();
+    // Thread safe: queues output for fd after everything posted before; keep=false closes it once flushed
+    void post(int fd, std::string output, bool keep = true);
+    // Serves WireProtocol clients on the same port; call before run()
+    void setFrameHandler(FrameHandler handler) { onFrame = std::move(handler); }
+
+    // Runs a batch of complete lines, or frames for a binary connection, as a worker task does;
+    // returns false once a handler asked to close (the rest of the batch is dropped)
+    static bool runBatch(int fd, std::string_view batch, bool binary, const CommandHandler& onCommand,
+                         const FrameHandler& onFrame, std::string& out);
+
+private:
+    struct Connection {
+        int fd;
+        LineBuffer input;                  // Complete lines wait here for a worker, then the partial one
+        std::deque<std::string> output;    // Reply chunks not yet accepted by the socket
+        size_t outputOffset = 0;           // Bytes of output.front() already sent
+        size_t outputBytes = 0;
+        std::string spare;                 // A sent reply buffer, cleared; the next batch writes into it
+        bool busy = false;                 // A worker is running one of its commands
+        bool closing = false;              // Close once idle and flushed
+        bool draining = false;             // onDrain was called
+        bool released = false;             // The final post() arrived
+        bool readPaused = false;           // Input left in the socket until the queues drain
+        bool waiting = false;              // In the queue for a pool slot
+        bool negotiated = false;           // The protocol is known (always, without onFrame)
+        bool binary = false;               // WireProtocol frames rather than text lines
+    };
+
+    // A finished command, posted by a worker for the reactor thread
+    struct Completion {
+        int fd;
+        std::string output;
+        bool keep;
+        bool posted = false;  // From post(), not the end of a command
+    };
+
+    void acceptAll();
+    void readAll(Connection& conn);
+    void flush(Connection& conn);
+    void queueOutput(Connection& conn, std::string text);
+    void discard(Connection& conn);
+    void recycle(Connection& conn, std::string&& buffer);
+    void dispatch(Connection& conn);
+    void drainCompletions();
+    void closeIfDone(Connection& conn);
+    void resumeRead(Connection& conn);
+    bool canRead(const Connection& conn) const;
+    void wake();
+
+    int listenFd;
+    int epollFd;
+    int wakeFd;
+    std::atomic<bool> stopping{false};  // Set by stop() from any thread
+    WorkStealingPool& workers;
+    OpenHandler onOpen;
+    CommandHandler onCommand;
+    CloseHandler onClose;
+    DrainHandler onDrain;
+    FrameHandler onFrame;
+    AdmissionLimits limits;
+    size_t inFlight = 0;                // Commands handed to the pool and not completed
+    std::deque<int> waitingForSlot;     // Connections with commands, blocked by maxInFlight
+
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;  // Reactor thread only
+    std::mutex completionsMutex;
+    std::vector<Completion> completions;
+};
+
+#endif // REACTOR_HPP
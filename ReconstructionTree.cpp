@@ -0,0 +1,236 @@
+#include "ReconstructionTree.hpp"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+const size_t BLOCK = 64;  // Nodes per RMQ block, one bit each in a stack mask
+
+size_t floorLog2(size_t value) {
+    return 63 - static_cast<size_t>(__builtin_clzll(value));
+}
+
+} // namespace
+
+void KruskalReconstructionTree::reset(size_t vertices) {
+    if (vertices >= NONE / 2) {
+        throw std::length_error("KruskalReconstructionTree: too many vertices");
+    }
+    clear();
+    leaves_ = vertices;
+    parent_.assign(vertices, NONE);
+    weight_.assign(vertices, -std::numeric_limits<double>::infinity());
+    leafCount_.assign(vertices, 1);
+    // A spanning forest adds at most V-1 internal nodes
+    parent_.reserve(2 * vertices);
+    weight_.reserve(2 * vertices);
+    leafCount_.reserve(2 * vertices);
+}
+
+/* Records that the components rooted at left and right were joined by an edge of the
+given weight. Kruskal calls this in nondecreasing weight order.
+*/
+size_t KruskalReconstructionTree::merge(size_t left, size_t right, double weight) {
+    uint32_t node = static_cast<uint32_t>(parent_.size());
+    parent_[left] = node;
+    parent_[right] = node;
+    parent_.push_back(NONE);
+    weight_.push_back(weight);
+    leafCount_.push_back(leafCount_[left] + leafCount_[right]);
+    indexed_ = false;
+    return node;
+}
+
+void KruskalReconstructionTree::clear() {
+    leaves_ = 0;
+    indexed_ = false;
+    parent_.clear();
+    weight_.clear();
+    leafCount_.clear();
+    depth_.clear();
+    root_.clear();
+    jump_.clear();
+    tin_.clear();
+    order_.clear();
+    stackMask_.clear();
+    blocks_ = 0;
+    blockSparse_.clear();
+}
+
+void KruskalReconstructionTree::buildIndex() {
+    const size_t n = parent_.size();
+
+    // Children in CSR form, only needed for the traversal
+    std::vector<uint32_t> childOffset(n + 1, 0);
+    for (size_t v = 0; v < n; ++v) {
+        if (parent_[v] != NONE) {
+            ++childOffset[parent_[v] + 1];
+        }
+    }
+    for (size_t v = 0; v < n; ++v) {
+        childOffset[v + 1] += childOffset[v];
+    }
+    std::vector<uint32_t> children(childOffset[n]);
+    {
+        std::vector<uint32_t> cursor(childOffset.begin(), childOffset.end() - 1);
+        for (size_t v = 0; v < n; ++v) {
+            if (parent_[v] != NONE) {
+                children[cursor[parent_[v]]++] = static_cast<uint32_t>(v);
+            }
+        }
+    }
+
+    // Iterative preorder DFS from every root; parents are visited before their children
+    depth_.assign(n, 0);
+    root_.assign(n, NONE);
+    jump_.assign(n, NONE);
+    tin_.assign(n, 0);
+    std::vector<uint32_t>& order = order_;
+    order.clear();
+    order.reserve(n);
+    std::vector<uint32_t> stack;
+    for (size_t r = 0; r < n; ++r) {
+        if (parent_[r] != NONE) {
+            continue;
+        }
+        stack.push_back(static_cast<uint32_t>(r));
+        while (!stack.empty()) {
+            uint32_t v = stack.back();
+            stack.pop_back();
+            tin_[v] = static_cast<uint32_t>(order.size());
+            order.push_back(v);
+
+            uint32_t p = parent_[v];
+            if (p == NONE) {
+                root_[v] = v;
+                jump_[v] = v;
+            } else {
+                depth_[v] = depth_[p] + 1;
+                root_[v] = root_[p];
+                // Skew-binary jump pointers give O(log depth) ancestor searches in O(1) space
+                uint32_t jp = jump_[p];
+                if (depth_[p] - depth_[jp] == depth_[jp] - depth_[jump_[jp]]) {
+                    jump_[v] = jump_[jp];
+                } else {
+                    jump_[v] = p;
+                }
+            }
+            for (uint32_t k = childOffset[v]; k < childOffset[v + 1]; ++k) {
+                stack.push_back(children[k]);
+            }
+        }
+    }
+
+    // Inside each block: the stack of suffix minima ending at every position, as a bit mask
+    stackMask_.assign(n, 0);
+    blocks_ = (n + BLOCK - 1) / BLOCK;
+    std::vector<uint32_t> blockMin(blocks_);
+    for (size_t b = 0; b < blocks_; ++b) {
+        size_t start = b * BLOCK;
+        size_t end = std::min(n, start + BLOCK);
+        uint64_t mask = 0;
+        for (size_t i = start; i < end; ++i) {
+            // Pop the positions that are not shallower than i, then push i
+            while (mask != 0) {
+                size_t top = start + floorLog2(mask);
+                if (depth_[order[top]] < depth_[order[i]]) {
+                    break;
+                }
+                mask &= ~(uint64_t(1) << (top - start));
+            }
+            mask |= uint64_t(1) << (i - start);
+            stackMask_[i] = mask;
+        }
+        blockMin[b] = order[start + static_cast<size_t>(__builtin_ctzll(stackMask_[end - 1]))];
+    }
+
+    // Sparse table over the block minima: level k covers 2^k blocks
+    size_t levels = blocks_ == 0 ? 0 : floorLog2(blocks_) + 1;
+    blockSparse_.assign(levels * blocks_, NONE);
+    std::copy(blockMin.begin(), blockMin.end(), blockSparse_.begin());
+    for (size_t k = 1; k < levels; ++k) {
+        const uint32_t* prev = &blockSparse_[(k - 1) * blocks_];
+        uint32_t* level = &blockSparse_[k * blocks_];
+        for (size_t b = 0; b + (size_t(1) << k) <= blocks_; ++b) {
+            level[b] = shallower(prev[b], prev[b + (size_t(1) << (k - 1))]);
+        }
+    }
+
+    indexed_ = true;
+}
+
+uint32_t KruskalReconstructionTree::shallower(uint32_t a, uint32_t b) const {
+    return depth_[a] <= depth_[b] ? a : b;
+}
+
+/* For u != v in the same tree with tin[u] < tin[v], the shallowest node in the preorder
+range (tin[u], tin[v]] is a child of the LCA on the path to v.
+*/
+size_t KruskalReconstructionTree::lca(size_t u, size_t v) const {
+    if (u == v) {
+        return u;
+    }
+    size_t l = tin_[u], r = tin_[v];
+    if (l > r) {
+        std::swap(l, r);
+    }
+    return parent_[rangeMin(l + 1, r)];
+}
+
+uint32_t KruskalReconstructionTree::inBlock(size_t l, size_t r) const {
+    size_t start = l / BLOCK * BLOCK;
+    uint64_t candidates = stackMask_[r] & (~uint64_t(0) << (l - start));
+    return order_[start + static_cast<size_t>(__builtin_ctzll(candidates))];
+}
+
+uint32_t KruskalReconstructionTree::rangeMin(size_t l, size_t r) const {
+    size_t lb = l / BLOCK, rb = r / BLOCK;
+    if (lb == rb) {
+        return inBlock(l, r);
+    }
+    uint32_t best = shallower(inBlock(l, lb * BLOCK + BLOCK - 1), inBlock(rb * BLOCK, r));
+    if (lb + 1 < rb) {
+        size_t first = lb + 1, count = rb - first;
+        size_t k = floorLog2(count);
+        const uint32_t* level = &blockSparse_[k * blocks_];
+        best = shallower(best, shallower(level[first], level[rb - (size_t(1) << k)]));
+    }
+    return best;
+}
+
+double KruskalReconstructionTree::bottleneck(size_t u, size_t v) const {
+    if (!indexed_) {
+        throw std::logic_error("KruskalReconstructionTree: index not built");
+    }
+    if (u >= leaves_ || v >= leaves_) {
+        throw std::out_of_range("KruskalReconstructionTree: vertex out of range");
+    }
+    if (u == v) {
+        return 0.0;
+    }
+    if (root_[u] != root_[v]) {
+        return std::numeric_limits<double>::infinity();
+    }
+    return weight_[lca(u, v)];
+}
+
+KruskalReconstructionTree::Component KruskalReconstructionTree::reachableUnder(size_t u, double w) const {
+    if (!indexed_) {
+        throw std::logic_error("KruskalReconstructionTree: index not built");
+    }
+    if (u >= leaves_) {
+        throw std::out_of_range("KruskalReconstructionTree: vertex out of range");
+    }
+    // Weights only grow towards the root, so take a jump whenever it stays under w
+    size_t x = u;
+    while (parent_[x] != NONE && weight_[parent_[x]] <= w) {
+        if (weight_[jump_[x]] <= w) {
+            x = jump_[x];
+        } else {
+            x = parent_[x];
+        }
+    }
+    return Component{x, leafCount_[x]};
+}
@@ -0,0 +1,68 @@
+#ifndef RECONSTRUCTIONTREE_HPP
+#define RECONSTRUCTIONTREE_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/* Kruskal reconstruction tree.
+Leaves 0..V-1 are the graph vertices. Every union performed by Kruskal's algorithm adds
+an internal node whose weight is the joining edge, with the two merged components as its
+children, so weights never decrease on the way up. As a consequence:
+  - the minimax (bottleneck) edge between u and v is the weight of their LCA;
+  - the vertices reachable from u using only edges <= w are the leaves under the highest
+    ancestor of u whose weight is <= w.
+buildIndex() prepares an O(1) LCA and O(log V) jump pointers for the ancestor climb. The
+LCA is a range-minimum query over the DFS order, cut into blocks of 64 nodes: a sparse
+table over the block minima covers whole blocks, and inside a block each node keeps a
+64-bit mask of the monotonic stack ending at it, so a partial block is one bit scan. The
+index takes about 30 bytes per node, linear in the size of the tree.
+*/
+class KruskalReconstructionTree {
+public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    // A set of vertices connected by edges under some threshold
+    struct Component {
+        size_t id;    // Reconstruction tree node that spans the component
+        size_t size;  // Number of graph vertices in it
+    };
+
+    KruskalReconstructionTree() = default;
+
+    void reset(size_t vertices);                         // V leaves, no merges
+    size_t merge(size_t left, size_t right, double weight);  // Returns the new node
+    void buildIndex();
+    void clear();
+    bool isValid() const { return indexed_; }
+    size_t getVertices() const { return leaves_; }
+
+    // Largest edge on the MST path between u and v; infinity if they are not connected
+    double bottleneck(size_t u, size_t v) const;
+    // Component containing u when only edges of weight <= w are kept
+    Component reachableUnder(size_t u, double w) const;
+
+private:
+    size_t lca(size_t u, size_t v) const;
+    uint32_t shallower(uint32_t a, uint32_t b) const;
+    uint32_t rangeMin(size_t l, size_t r) const;  // Shallowest node in order_[l .. r]
+    uint32_t inBlock(size_t l, size_t r) const;   // The same, l and r in one block
+
+    size_t leaves_ = 0;
+    bool indexed_ = false;
+    std::vector<uint32_t> parent_;
+    std::vector<double> weight_;       // Joining edge weight (-infinity for leaves)
+    std::vector<uint32_t> leafCount_;
+
+    // Index built by buildIndex()
+    std::vector<uint32_t> depth_;
+    std::vector<uint32_t> root_;       // Root of the tree that contains the node
+    std::vector<uint32_t> jump_;       // Jump pointer, an ancestor O(log depth) levels up
+    std::vector<uint32_t> tin_;        // Position in DFS preorder
+    std::vector<uint32_t> order_;      // Nodes in DFS preorder
+    std::vector<uint64_t> stackMask_;  // Bit j: position (block start + j) is on the min stack ending here
+    size_t blocks_ = 0;
+    std::vector<uint32_t> blockSparse_;  // [k * blocks_ + b]: shallowest node in blocks b .. b + 2^k
+};
+
+#endif // RECONSTRUCTIONTREE_HPP
@@ -0,0 +1,63 @@
+#ifndef REPLYWRITER_HPP
+#define REPLYWRITER_HPP
+
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <type_traits>
+
+/* Appends reply text to a caller-owned buffer (usually the connection's reusable output).
+Numbers are formatted with std::to_chars on the stack and appended, so there is no
+ostringstream, no temporary std::string, and nothing is allocated once the buffer has
+reached its working size. The output is byte-for-byte what the old code produced:
+doubles written with << look like a default ostream's (%g, 6 significant digits), and
+fixed(x) looks like std::to_string's (%f).
+*/
+class ReplyWriter {
+public:
+    struct Fixed {
+        double value;
+    };
+    // writer << ReplyWriter::fixed(x) prints x the way std::to_string(x) does
+    static Fixed fixed(double value) { return Fixed{value}; }
+
+    explicit ReplyWriter(std::string& out) : out_(out) {}
+
+    ReplyWriter& operator<<(std::string_view text) {
+        out_.append(text.data(), text.size());
+        return *this;
+    }
+
+    ReplyWriter& operator<<(char c) {
+        out_.push_back(c);
+        return *this;
+    }
+
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, char> && !std::is_same_v<T, bool>>>
+    ReplyWriter& operator<<(T value) {
+        char buffer[24];
+        append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), value).ptr);
+        return *this;
+    }
+
+    ReplyWriter& operator<<(double value) {
+        char buffer[32];
+        append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::general, 6).ptr);
+        return *this;
+    }
+
+    ReplyWriter& operator<<(Fixed number) {
+        char buffer[328];  // DBL_MAX has 309 integer digits
+        append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), number.value, std::chars_format::fixed, 6).ptr);
+        return *this;
+    }
+
+    std::string& str() { return out_; }
+
+private:
+    void append(const char* begin, const char* end) { out_.append(begin, static_cast<size_t>(end - begin)); }
+
+    std::string& out_;
+};
+
+#endif // REPLYWRITER_HPP
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <cstring>
+#include <cerrno>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -14,17 +15,37 @@
 #include <condition_variable>
 #include <functional>
 #include <vector>
+#include <algorithm>
 #include <boost/asio.hpp>
+#include <unordered_map>
+#include <memory>
+#include <system_error>
+#include <limits>
 #include "Graph.hpp"
 #include "Tree.hpp"
 #include "MSTFactory.hpp"
+#include "LeaderFollowers.hpp"
+#include "Reactor.hpp"
+#include "UringServer.hpp"
+#include "LineBuffer.hpp"
+#include "ThreadPool.hpp"
+#include "CpuTopology.hpp"
+#include "TreeSerializer.hpp"
+#include "WireProtocol.hpp"
+#include "GraphCommands.hpp"
+#include "GraphStore.hpp"
+#include "Logger.hpp"
+#include "Stats.hpp"
+#include "AdminServer.hpp"
 
 #define PORT "9034"  // Port to listen on
-#define BACKLOG 10   // Number of pending connections queue will hold
+#define BACKLOG 128  // Number of pending connections queue will hold
+#define READ_CHUNK 16384  // Bytes asked of each recv
 
 using namespace std;
 
 int sockfd; // Global socket descriptor for cleanup
+GraphStore* store = nullptr;  // Set when named graphs are kept across restarts (-d)
 
 // Function to extract address information from sockaddr structure
 void *get_in_addr(struct sockaddr *sa) {
@@ -34,153 +55,365 @@ void *get_in_addr(struct sockaddr *sa) {
     return &(((struct sockaddr_in6*)sa)->sin6_addr);
 }
 
-// Signal handler to properly close the socket on SIGINT or SIGTERM
-void signalHandler(int signum) {
+// Sends the whole buffer, retrying after partial writes
+bool sendAll(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += sent;
+        length -= (size_t)sent;
+    }
+    return true;
+}
+
+// SIGINT and SIGTERM are blocked in every thread and taken here by sigwait, so closing the
+// socket, committing the journal and flushing the log run in normal context, not in a handler
+void shutdownOnSignal(sigset_t signals) {
+    int signum = 0;
+    if (sigwait(&signals, &signum) != 0) {
+        return;
+    }
     if (sockfd != -1) {
         close(sockfd);
     }
-    std::cout << "\nServer shutting down gracefully...\n";
-    exit(signum);
+    if (store != nullptr) {
+        store->commitNow();  // Edits still buffered by the journal's group commit
+    }
+    LOG(INFO) << "Server shutting down gracefully...";
+    Logger::shared().flush();
+    std::cout.flush();
+    // The I/O and compute threads are still running: exit() would destroy the statics they
+    // use (registry, pools, stats) under them, so leave without running destructors
+    _exit(signum);
 }
 
-// Function to handle client requests and execute the binary
-void handleRequest(int client_fd) {
-    std::cout << "Handling request..." << std::endl;
-
-    char buffer[1024];
-    std::string command;
-    Graph graph(5); // Default graph with 5 vertices
-    Tree mst;
-    
-    while (true) {
-        memset(buffer, 0, sizeof(buffer));
-        int bytes_received = recv(client_fd, buffer, sizeof(buffer) - 1, 0);  // Receive command from client
-        if (bytes_received <= 0) {
-            break;  // Exit loop if the connection is closed or there's an error
-        }
+// Per-connection state. Only one thread touches it at a time, because the connection's
+// handle is one-shot in the Leader/Followers set while a command is being processed.
+struct Session : GraphSession {
+    LineBuffer input;              // Leader/Followers mode: bytes received but not yet run
+    bool negotiated = false;       // Leader/Followers mode: text or WireProtocol decided
+    bool binary = false;
+    std::string output;            // Leader/Followers mode: replies of one read, buffer reused
+};
+
+// Every text command this server understands
+const CommandTable<Session>& commands() {
+    static const CommandTable<Session> table = [] {
+        CommandTable<Session> table;
+        GraphCommands::addTo(table);
+        table.add("MST", GraphCommands::mst);
+        table.add("calculate_mst_data", GraphCommands::mstData);
+        return table;
+    }();
+    return table;
+}
 
-        command = std::string(buffer);
-        command = command.substr(0, command.find("\n")); // Remove trailing newline character
-        std::cout << "Received command: " << command << std::endl;
+// Executes one command for the client, appending the response to out
+void handleCommand(Session& session, const std::string& command, std::string& out) {
+    if (!commands().dispatch(session, command, out)) {
+        out += "Unknown command\n";
+    }
+}
 
-        if (command == "end") {
-            break;
-        }
-        
-        std::istringstream iss(command);
-        std::string action;
-        iss >> action;
-
-        // Create a new graph
-        if (action == "new_graph") {
-            int num_vertices;
-            iss >> num_vertices;
-            graph = Graph(num_vertices); // Create a new graph with the specified number of vertices
-            std::string response = "New graph created with " + std::to_string(num_vertices) + " vertices.\n";
-            send(client_fd, response.c_str(), response.length(), 0);
-        }
-        // Add edge: format "add_edge vertex1 vertex2 weight"
-        else if (action == "add_edge") {
-            size_t v1, v2;
-            double weight;
-            iss >> v1 >> v2 >> weight;
-            graph.addEdge(v1, v2, weight);
-            std::string response = "Edge added between " + to_string(v1) + " and " + to_string(v2) + " with weight " + std::to_string(weight) + ".\n";
-            send(client_fd, response.c_str(), response.length(), 0);
+// frame_seconds{frame="..."}: the run time of each WireProtocol request type
+Stats::Id frameTiming(uint8_t type) {
+    static const char* const NAMES[] = {"unknown", "NEW_GRAPH", "ADD_EDGES", "REMOVE_EDGES", "MST", "METRICS", "END", "OPEN_GRAPH"};
+    static const std::vector<Stats::Id> histograms = [] {
+        std::vector<Stats::Id> ids;
+        for (const char* name : NAMES) {
+            ids.push_back(Stats::histogram("frame_seconds", std::string("frame=\"") + name + "\""));
         }
-        // Remove edge: format "remove_edge vertex1 vertex2"
-        else if (action == "remove_edge") {
-            size_t v1, v2;
-            iss >> v1 >> v2;
-            graph.removeEdge(v1, v2);
-            std::string response = "Edge removed between " + std::to_string(v1) + " and " + std::to_string(v2) + ".\n";
-            send(client_fd, response.c_str(), response.length(), 0);
-        }
-        // Build MST using specified algorithm and return tree
-        else if (action == "MST") {
-            std::string algorithm;
-            iss >> algorithm;
-            
-            if (algorithm == "Kruskal") {
-                auto mstStrategy = MSTFactory::createMSTStrategy(MSTFactory::Algorithm::KRUSKAL);
-                mst = mstStrategy->computeMST(graph);
-            } 
-            else if (algorithm == "Prim") {
-                auto mstStrategy = MSTFactory::createMSTStrategy(MSTFactory::Algorithm::PRIM);
-                mst = mstStrategy->computeMST(graph);
-            } 
-            else if (algorithm == "Boruvka") {
-                auto mstStrategy = MSTFactory::createMSTStrategy(MSTFactory::Algorithm::Boruvka);
-                mst = mstStrategy->computeMST(graph);
-            } 
-            else if (algorithm == "Tarjan") {
-                auto mstStrategy = MSTFactory::createMSTStrategy(MSTFactory::Algorithm::Tarjan);
-                mst = mstStrategy->computeMST(graph);
+        return ids;
+    }();
+    return histograms[type < histograms.size() ? type : 0];
+}
+
+// Executes one WireProtocol request, appending its reply frame to out; returns false after END
+bool handleFrame(Session& session, uint8_t type, std::string_view payload, std::string& out) {
+    WireProtocol::Reader reader(payload);
+    ScopedTimer timer(frameTiming(type));
+
+    try {
+        switch (static_cast<WireProtocol::Frame>(type)) {
+            case WireProtocol::Frame::NEW_GRAPH: {
+                uint32_t vertices = reader.u32();
+                std::string name(reader.rest());  // Empty: a private graph
+                if (vertices > (uint32_t)std::numeric_limits<int>::max()) {
+                    throw std::out_of_range("NEW_GRAPH: too many vertices");
+                }
+                session.attach(name.empty() ? std::make_shared<SharedGraph>((int)vertices)
+                                            : GraphRegistry::shared().create(name, (int)vertices), name);
+                WireProtocol::endReply(out, WireProtocol::beginReply(out, type, WireProtocol::Status::OK));
+                return true;
             }
-            else if (algorithm == "Integer") {
-                auto mstStrategy = MSTFactory::createMSTStrategy(MSTFactory::Algorithm::Integer);
-                mst = mstStrategy->computeMST(graph);
+            // The whole batch goes straight into the adjacency vectors, acknowledged once
+            case WireProtocol::Frame::ADD_EDGES: {
+                uint32_t count = reader.u32();
+                if (reader.remaining() != (size_t)count * 16) {
+                    throw std::runtime_error("ADD_EDGES: payload does not match the edge count");
+                }
+                std::vector<Graph::WeightedEdge> edges(count);
+                for (Graph::WeightedEdge& edge : edges) {
+                    edge.u = reader.u32();
+                    edge.v = reader.u32();
+                    edge.weight = reader.f64();
+                }
+                session.graph->addEdges(edges);
+                size_t start = WireProtocol::beginReply(out, type, WireProtocol::Status::OK);
+                WireProtocol::putU32(out, count);
+                WireProtocol::endReply(out, start);
+                return true;
             }
-            else {
-                const char *error_msg = "Unknown MST algorithm\n";
-                send(client_fd, error_msg, strlen(error_msg), 0);
-                continue;
+            case WireProtocol::Frame::REMOVE_EDGES: {
+                uint32_t count = reader.u32();
+                if (reader.remaining() != (size_t)count * 8) {
+                    throw std::runtime_error("REMOVE_EDGES: payload does not match the edge count");
+                }
+                std::vector<std::pair<uint32_t, uint32_t>> pairs(count);
+                for (auto& pair : pairs) {
+                    pair.first = reader.u32();
+                    pair.second = reader.u32();
+                }
+                session.graph->removeEdges(pairs);
+                size_t start = WireProtocol::beginReply(out, type, WireProtocol::Status::OK);
+                WireProtocol::putU32(out, count);
+                WireProtocol::endReply(out, start);
+                return true;
             }
-
-            // Send back the MST result to the client
-            std::ostringstream oss;
-            oss << "MST Computed using " << algorithm << ":" << std::endl;
-            mst.printTree(oss);  // Assuming printTree can accept an ostream
-            std::string result = oss.str();
-            send(client_fd, result.c_str(), result.length(), 0);
-            
-
-        }
-        else if (action == "calculate_mst_data") {
-            if (!mst.isValid()) {
-                const char *error_msg = "MST not computed yet. Please compute MST first.\n";
-                send(client_fd, error_msg, strlen(error_msg), 0);
-                continue;
+            case WireProtocol::Frame::OPEN_GRAPH: {
+                std::string name(reader.rest());
+                std::shared_ptr<SharedGraph> shared = GraphRegistry::shared().find(name);
+                if (!shared) {
+                    throw std::runtime_error("No graph named " + name);
+                }
+                session.attach(std::move(shared), name);
+                size_t start = WireProtocol::beginReply(out, type, WireProtocol::Status::OK);
+                WireProtocol::putU32(out, (uint32_t)session.graph->snapshot()->graph.getVertices());
+                WireProtocol::endReply(out, start);
+                return true;
             }
-
-            // Perform the data calculations
-            double totalWeight = mst.calculateTotalWeight();
-            double longestDistance = mst.calculateLongestDistance();
-            double averageDistance = mst.calculateAverageDistance();
-            double shortestDistance = mst.calculateShortestDistance();
-
-            // Prepare the response
-            std::ostringstream oss;
-            oss << "MST Data:\n";
-            oss << "Total Weight: " << totalWeight << "\n";
-            oss << "Longest Distance: " << longestDistance << "\n";
-            oss << "Average Distance: " << averageDistance << "\n";
-            oss << "Shortest Distance: " << shortestDistance << "\n";
-            std::string result = oss.str();
-
-            // Send the response to the client
-            send(client_fd, result.c_str(), result.length(), 0);
+            case WireProtocol::Frame::MST: {
+                uint64_t start = Stats::now();
+                uint8_t algorithm = reader.u8();
+                uint8_t encoding = reader.u8();
+                if (algorithm > (uint8_t)MSTFactory::Algorithm::Integer) {
+                    throw std::runtime_error("Unknown MST algorithm");
+                }
+                if (encoding > (uint8_t)TreeSerializer::Encoding::VARINT) {
+                    throw std::runtime_error("Unknown tree encoding");
+                }
+                MSTFactory::Algorithm chosen = static_cast<MSTFactory::Algorithm>(algorithm);
+                Stats::record(GraphCommands::mstTiming(chosen, GraphCommands::MstPhase::PARSE), Stats::now() - start);
+                GraphCommands::computeMst(session, chosen);
+                ScopedTimer format(GraphCommands::mstTiming(chosen, GraphCommands::MstPhase::FORMAT));
+                size_t reply = WireProtocol::beginReply(out, type, WireProtocol::Status::OK);
+                TreeSerializer::write(*session.mst, out, static_cast<TreeSerializer::Encoding>(encoding));
+                WireProtocol::endReply(out, reply);
+                return true;
+            }
+            case WireProtocol::Frame::METRICS: {
+                if (!session.mst || !session.mst->isValid()) {
+                    throw std::runtime_error("MST not computed yet");
+                }
+                TreeMetrics metrics = session.mst->calculateMetrics();
+                size_t start = WireProtocol::beginReply(out, type, WireProtocol::Status::OK);
+                WireProtocol::putF64(out, metrics.totalWeight);
+                WireProtocol::putF64(out, metrics.longestDistance);
+                WireProtocol::putF64(out, metrics.averageDistance);
+                WireProtocol::putF64(out, metrics.shortestDistance);
+                WireProtocol::putU32(out, (uint32_t)metrics.edgeCount);
+                WireProtocol::endReply(out, start);
+                return true;
+            }
+            case WireProtocol::Frame::END:
+                WireProtocol::endReply(out, WireProtocol::beginReply(out, type, WireProtocol::Status::OK));
+                return false;
         }
+        throw std::runtime_error("Unknown frame type");
+    } catch (const std::exception& e) {
+        WireProtocol::appendError(out, type, e.what());
+        return true;
+    }
+}
 
-        // Print the current graph
-        else if (action == "print_graph") {
-            std::ostringstream oss;
-            graph.printGraph(oss);  // Assuming printGraph can accept an ostream
-            std::string result = oss.str();
-            send(client_fd, result.c_str(), result.length(), 0);
+// Reads what the client has sent and executes every complete command (or frame) in it,
+// replying with one send; returns false once the client is done
+bool handleRequest(Session& session, int client_fd) {
+    char *space = session.input.prepare(READ_CHUNK);
+    ssize_t bytes_received = recv(client_fd, space, session.input.writable(), 0);  // Receive commands from client
+    if (bytes_received <= 0) {
+        return false;  // The connection is closed or there's an error
+    }
+    session.input.commit((size_t)bytes_received);
+    Stats::add(FrontEndStats::shared().bytesReceived, bytes_received);
+    std::string& response = session.output;
+    response.clear();
+    if (!session.negotiated) {
+        session.negotiated = WireProtocol::negotiate(session.input, session.binary, response);
+    }
+    if (session.input.partialSize() > (session.binary ? WireProtocol::MAX_FRAME : Reactor::MAX_LINE)) {
+        std::string error_msg = session.binary ? WireProtocol::frameTooLarge() : std::string("Command too long\n");
+        sendAll(client_fd, error_msg.data(), error_msg.size());
+        return false;
+    }
+    if (!session.negotiated) {
+        return true;  // Only part of the binary hello so far
+    }
+
+    std::string_view pending = session.input.completeLines(), line;
+    std::string command;
+    bool keep = true;
+    uint8_t type;
+    while (session.binary && keep && LineBuffer::nextFrame(pending, type, line)) {
+        keep = handleFrame(session, type, line, response);
+    }
+    while (!session.binary && keep && LineBuffer::nextLine(pending, line)) {
+        command.assign(line.data(), line.size());
+        LOG(DEBUG) << "Received command: " << command;
+        if (command == "end") {
+            keep = false;
+            continue;
         }
-        else {
-            const char *error_msg = "Unknown command\n";
-            send(client_fd, error_msg, strlen(error_msg), 0);
+        try {
+            handleCommand(session, command, response);
+        } catch (const std::exception& e) {
+            response += std::string("Error: ") + e.what() + "\n";
         }
     }
+    session.input.consumeLines();
+    uint64_t start = Stats::now();
+    bool sent = sendAll(client_fd, response.data(), response.size());
+    Stats::record(FrontEndStats::shared().sendTime, Stats::now() - start);
+    if (sent) {
+        Stats::add(FrontEndStats::shared().bytesSent, (int64_t)response.size());
+    }
+    return sent && keep;
+}
 
-    close(client_fd);
-    std::cout << "Request handled." << std::endl;
+
+// Prints the command line options
+void usage(const char *program) {
+    std::cerr << "Usage: " << program << " [-m reactor|uring|lf] [-i io_threads] [-c compute_threads] [-p]\n"
+              << "       [-n max_connections] [-q queued_per_client] [-f max_in_flight] [-d data_dir] [-s seconds]\n"
+              << "       [-l level[:N]] [-a admin_port]\n"
+              << "  -m  front end: epoll reactor feeding the compute pool (default), the same over io_uring,\n"
+              << "      or Leader/Followers\n"
+              << "  -i  Leader/Followers threads serving connections (default: max(2, CPUs / 2))\n"
+              << "  -c  threads in the compute pool (default: available CPUs)\n"
+              << "  -p  pin I/O threads to the first CPUs (at most -i of them) and compute threads to the rest\n"
+              << "  -n  connections beyond this are told to retry later (default: 4096)\n"
+              << "  -q  commands queued per client before its socket is no longer read (default: 64)\n"
+              << "  -f  commands running or queued in the compute pool (default: 4 per compute thread)\n"
+              << "  -d  keep named graphs in this directory (snapshots and journal) and reload them on start\n"
+              << "  -s  seconds between snapshots of the graphs that changed (default: 300)\n"
+              << "  -l  log level: debug (every command), info (default), warn, error or off;\n"
+              << "      level:N keeps 1 in N debug and info records\n"
+              << "  -a  serve Prometheus metrics at http://127.0.0.1:admin_port/metrics (default: off;\n"
+              << "      the stats command shows the same counters and latencies to clients)\n";
 }
 
+int main(int argc, char *argv[]) {
+    // Block the shutdown signals before any thread starts, so every thread inherits the mask
+    sigset_t shutdownSignals;
+    sigemptyset(&shutdownSignals);
+    sigaddset(&shutdownSignals, SIGINT);
+    sigaddset(&shutdownSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &shutdownSignals, nullptr);
+    // Size the pools from the CPUs this process may actually use (affinity and cgroup quota)
+    PoolConfig poolConfig = PoolConfig::defaults();
+    AdmissionLimits limits;
+    std::string frontEnd = "reactor";
+    GraphStore::Options storeOptions;
+    unsigned long adminPort = 0;
+    unsigned long value = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "m:i:c:pn:q:f:d:s:l:a:")) != -1) {
+        // The numeric options must be whole numbers
+        if (std::strchr("icnqfsa", opt) != nullptr && !CommandArgs::parse(optarg, value)) {
+            usage(argv[0]);
+            return 1;
+        }
+        switch (opt) {
+            case 'm':
+                frontEnd = optarg;
+                if (frontEnd != "reactor" && frontEnd != "uring" && frontEnd != "lf") {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'i':
+                poolConfig.ioThreads = std::max(1ul, value);
+                break;
+            case 'c':
+                poolConfig.computeThreads = std::max(1ul, value);
+                break;
+            case 'p':
+                poolConfig.pin = true;
+                break;
+            case 'n':
+                limits.maxConnections = std::max(1ul, value);
+                break;
+            case 'q':
+                limits.maxQueuedCommands = std::max(1ul, value);
+                break;
+            case 'f':
+                limits.maxInFlight = std::max(1ul, value);
+                break;
+            case 'd':
+                storeOptions.directory = optarg;
+                break;
+            case 's':
+                storeOptions.snapshotSeconds = (unsigned)std::max(1ul, value);
+                break;
+            case 'l':
+                if (!Logger::shared().configure(optarg)) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'a':
+                adminPort = value;
+                if (adminPort == 0 || adminPort > 65535) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (poolConfig.pinnedPoolsOverlap()) {
+        LOG(WARN) << "server: only one CPU allowed, compute and I/O threads are pinned to the same CPU";
+    }
+    WorkStealingPool::configureCompute(poolConfig.computeThreads, poolConfig.computeCpus());
+    // Recovery builds the graphs on the compute pool, before any client can connect
+    std::unique_ptr<GraphStore> graphStore;
+    if (!storeOptions.directory.empty()) {
+        try {
+            graphStore = std::make_unique<GraphStore>(storeOptions);
+            graphStore->open();
+        } catch (const std::exception& e) {
+            std::cerr << "server: cannot open data directory " << storeOptions.directory << ": " << e.what() << std::endl;
+            return 1;
+        }
+        store = graphStore.get();
+    }
+    std::unique_ptr<AdminServer> admin;
+    if (adminPort != 0) {
+        try {
+            admin = std::make_unique<AdminServer>((uint16_t)adminPort);
+        } catch (const std::system_error& e) {
+            cerr << "server: admin port " << adminPort << ": " << e.what() << endl;
+            return 1;
+        }
+    }
 
-int main() {
     struct addrinfo hints, *servinfo, *p;
     struct sockaddr_storage their_addr;
     socklen_t sin_size;
@@ -188,9 +421,8 @@ int main() {
     char s[INET6_ADDRSTRLEN];
     int rv;
 
-    // Register signal handlers to clean up on SIGINT and SIGTERM
-    signal(SIGINT, signalHandler);
-    signal(SIGTERM, signalHandler);
+    // Clean up on SIGINT and SIGTERM (blocked since the start of main)
+    std::thread(shutdownOnSignal, shutdownSignals).detach();
 
     memset(&hints, 0, sizeof hints);
     hints.ai_family = AF_INET;  // Use AF_INET for IPv4
@@ -237,25 +469,137 @@ int main() {
         return 1;
     }
 
-    cout << "server: waiting for connections..." << endl;
+    LOG(INFO) << "server: waiting for connections (" << frontEnd << ", " << poolConfig.ioThreads << " I/O threads, "
+              << poolConfig.computeThreads << " compute threads" << (poolConfig.pin ? ", pinned" : "") << ")...";
 
-    LeaderFollower leaderFollower(4); // Create a thread pool with 4 threads
+    std::unordered_map<int, std::unique_ptr<Session>> sessions;
+    std::mutex sessionsMutex;
 
-    while (true) {
-        sin_size = sizeof their_addr;
-        int new_fd = accept(sockfd, (struct sockaddr *)&their_addr, &sin_size);
-        if (new_fd == -1) {
-            perror("accept");
-            continue;
+    if (frontEnd == "reactor" || frontEnd == "uring") {
+        // One I/O thread owns every socket; only complete commands reach the compute pool
+        auto onOpen = [&](int fd) {
+            struct sockaddr_storage peer;
+            socklen_t peerSize = sizeof peer;
+            char address[INET6_ADDRSTRLEN] = "?";
+            if (getpeername(fd, (struct sockaddr *)&peer, &peerSize) == 0) {
+                inet_ntop(peer.ss_family, get_in_addr((struct sockaddr *)&peer), address, sizeof address);
+            }
+            LOG(INFO) << "server: got connection from " << address;
+            std::lock_guard<std::mutex> lock(sessionsMutex);
+            sessions[fd] = std::make_unique<Session>();
+        };
+        auto onCommand = [&](int fd, const std::string& command, std::string& out) -> bool {
+            LOG(DEBUG) << "Received command: " << command;
+            if (command == "end") {
+                return false;
+            }
+            Session *session;
+            {
+                std::lock_guard<std::mutex> lock(sessionsMutex);
+                session = sessions.at(fd).get();
+            }
+            handleCommand(*session, command, out);
+            return true;
+        };
+        auto onFrame = [&](int fd, uint8_t type, std::string_view payload, std::string& out) -> bool {
+            Session *session;
+            {
+                std::lock_guard<std::mutex> lock(sessionsMutex);
+                session = sessions.at(fd).get();
+            }
+            return handleFrame(*session, type, payload, out);
+        };
+        auto onClose = [&](int fd) {
+            {
+                std::lock_guard<std::mutex> lock(sessionsMutex);
+                sessions.erase(fd);
+            }
+            LOG(INFO) << "Request handled.";
+        };
+
+        std::vector<int> ioCpus = poolConfig.ioCpus();
+        if (!ioCpus.empty()) {
+            pinCurrentThread(ioCpus.front());
+        }
+        if (frontEnd == "uring") {
+            std::unique_ptr<UringServer> uring;
+            try {
+                uring = std::make_unique<UringServer>(sockfd, WorkStealingPool::compute(), onOpen, onCommand, onClose, limits);
+            } catch (const std::system_error& e) {
+                LOG(WARN) << "server: io_uring unavailable (" << e.what() << "), using the epoll reactor";
+            }
+            if (uring) {
+                LOG(INFO) << "server: io_uring ready" << (uring->zeroCopySupported() ? ", zero-copy sends" : "");
+                uring->setFrameHandler(onFrame);
+                uring->run();
+                close(sockfd);
+                return 0;
+            }
+        }
+        Reactor reactor(sockfd, WorkStealingPool::compute(), onOpen, onCommand, onClose, nullptr, limits);
+        reactor.setFrameHandler(onFrame);
+        reactor.run();
+        close(sockfd);
+        return 0;
+    }
+
+    LeaderFollowersPool *poolPtr = nullptr;
+
+    // Runs on whichever thread is leader when fd becomes readable
+    auto onEvent = [&](int fd) -> bool {
+        if (fd == sockfd) {
+            sin_size = sizeof their_addr;
+            int new_fd = accept(sockfd, (struct sockaddr *)&their_addr, &sin_size);
+            if (new_fd == -1) {
+                LOG(WARN) << "accept: " << strerror(errno);
+                return true;
+            }
+
+            inet_ntop(their_addr.ss_family, get_in_addr((struct sockaddr *)&their_addr), s, sizeof s);
+            LOG(INFO) << "server: got connection from " << s;
+            {
+                std::lock_guard<std::mutex> lock(sessionsMutex);
+                if (sessions.size() >= limits.maxConnections) {
+                    std::string reply = limits.busyReply();
+                    sendAll(new_fd, reply.data(), reply.size());
+                    close(new_fd);
+                    Stats::add(FrontEndStats::shared().connectionsRejected);
+                    return true;
+                }
+                sessions[new_fd] = std::make_unique<Session>();
+            }
+            Stats::add(FrontEndStats::shared().connectionsAccepted);
+            Stats::add(FrontEndStats::shared().connectionsActive);
+            poolPtr->addHandle(new_fd);
+            return true;  // Keep listening
         }
 
-        inet_ntop(their_addr.ss_family, get_in_addr((struct sockaddr *)&their_addr), s, sizeof s);
-        cout << "server: got connection from " << s << endl;
+        Session *session;
+        {
+            std::lock_guard<std::mutex> lock(sessionsMutex);
+            session = sessions.at(fd).get();
+        }
+        return handleRequest(*session, fd);
+    };
 
-        leaderFollower.submitTask([new_fd]() {
-            handleRequest(new_fd);
-        });
-    }
+    auto onClose = [&](int fd) {
+        if (fd == sockfd) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(sessionsMutex);
+            sessions.erase(fd);
+        }
+        close(fd);
+        Stats::add(FrontEndStats::shared().connectionsActive, -1);
+        LOG(INFO) << "Request handled.";
+    };
+
+    // The I/O threads take turns leading the epoll set
+    LeaderFollowersPool pool(poolConfig.ioThreads, onEvent, onClose, poolConfig.ioCpus());
+    poolPtr = &pool;
+    pool.addHandle(sockfd);
+    pool.join();
 
     close(sockfd);  // Ensure socket is closed before exit
     return 0;
@@ -263,6 +607,9 @@ int main() {
 
 //**************************** how to run the code **********************************//
 
+// ./server [-m reactor|uring|lf] [-i io_threads] [-c compute_threads] [-p] [-n max_connections] [-q queued_per_client] [-f max_in_flight] [-d data_dir] [-s seconds] [-l level[:N]] [-a admin_port]
+// With -d, named graphs survive restarts: ./server -d /var/lib/mst reloads them on start
+// With -a 9100, curl http://127.0.0.1:9100/metrics returns the counters and latencies in the Prometheus format
 
 // nc 127.0.0.1 9034
 // new_graph 5
@@ -292,8 +639,40 @@ int main() {
 // Edge 0-1 with weight 2.0
 // Edge 0-2 with weight 3.0
 
+// MST Prim binary varint
+// "MST Computed using Prim (binary, 36 bytes):" followed by the TreeSerializer payload
+
+// new_graph roads 5
+// "New graph roads created with 5 vertices." -- a named graph, shared by every client
+// open_graph roads   (from another connection)
+// "Opened graph roads with 5 vertices."
+
+// Bulk loads use the binary protocol on the same port instead (see WireProtocol.hpp):
+// send "\0MSP\1", then frames such as ADD_EDGES with thousands of packed edges each
+
 // calculate_mst_data
 
+// bottleneck 1 2
+// "Bottleneck edge between 1 and 2: 3"
+
+// reachable_under 1 2.5
+// "Component 5 of size 2"
+
+// cluster 2 3
+// "Clusters (k=2): sizes 3 2
+// Labels: 0 0 0 1 1
+// Clusters (k=3): sizes 2 1 2
+// Labels: 0 0 1 2 2"
+
+// stats
+// "command_seconds{command="MST"} count=1 mean=41.2us p50=40.9us ..." -- one line per counter and histogram
+
+// trace
+// {"traceEvents":[...]} -- the MST phase spans as Chrome trace JSON, in a build made with make TRACE=1
+
+// ping
+// "pong" -- after the replies to everything sent before it; loadgen uses it to find where they end
+
 // remove_edge 1 2
 // "Edge removed between 1 and 2."
 
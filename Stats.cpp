@@ -0,0 +1,253 @@
+#include "Stats.hpp"
+#include "ReplyWriter.hpp"
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+const size_t MAX_VALUES = 256;       // Counters and gauges
+const size_t MAX_HISTOGRAMS = 256;
+const unsigned SUB_BITS = 4;
+const size_t SUB_BUCKETS = size_t(1) << SUB_BITS;  // Per power of two
+const size_t BUCKETS = SUB_BUCKETS * (64 - SUB_BITS + 1);
+const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+
+enum class Kind { COUNTER, GAUGE, HISTOGRAM };
+
+struct Metric {
+    std::string name;
+    std::string labels;
+    Kind kind;
+    Stats::Id slot;
+};
+
+struct HistogramShard {
+    std::array<std::atomic<uint64_t>, BUCKETS> buckets{};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> max{0};
+};
+
+// Written by its thread only; read by anyone
+struct Shard {
+    std::array<std::atomic<int64_t>, MAX_VALUES> values{};
+    std::array<std::atomic<HistogramShard*>, MAX_HISTOGRAMS> histograms{};
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<Metric> metrics;  // In registration order
+    size_t values = 0;
+    size_t histograms = 0;
+    std::vector<Shard*> shards;   // Never freed: a thread's counts outlive it
+};
+
+Registry& registry() {
+    static Registry* instance = new Registry();
+    return *instance;
+}
+
+Shard& localShard() {
+    thread_local Shard* shard = nullptr;
+    if (shard == nullptr) {
+        shard = new Shard();
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.shards.push_back(shard);
+    }
+    return *shard;
+}
+
+// Single writer, so a load and a store replace the read-modify-write
+template <typename T>
+void bump(std::atomic<T>& value, T delta) {
+    value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+size_t bucketOf(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return value;
+    }
+    unsigned shift = (unsigned)(63 - __builtin_clzll(value)) - SUB_BITS;
+    return (shift + 1) * SUB_BUCKETS + ((value >> shift) & (SUB_BUCKETS - 1));
+}
+
+// Middle of the values that fall into the bucket
+uint64_t bucketValue(size_t index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    unsigned shift = (unsigned)(index / SUB_BUCKETS - 1);
+    uint64_t low = (uint64_t)(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+    return low + ((uint64_t(1) << shift) >> 1);
+}
+
+Stats::Id registerMetric(const std::string& name, const std::string& labels, Kind kind) {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (const Metric& metric : reg.metrics) {
+        if (metric.name == name && metric.labels == labels && metric.kind == kind) {
+            return metric.slot;
+        }
+    }
+    size_t& used = kind == Kind::HISTOGRAM ? reg.histograms : reg.values;
+    if (used == (kind == Kind::HISTOGRAM ? MAX_HISTOGRAMS : MAX_VALUES)) {
+        throw std::length_error("Stats: too many metrics");
+    }
+    reg.metrics.push_back(Metric{name, labels, kind, (Stats::Id)used});
+    return (Stats::Id)used++;
+}
+
+// A histogram summed over every shard
+struct Merged {
+    std::vector<uint64_t> buckets = std::vector<uint64_t>(BUCKETS, 0);
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+
+    uint64_t quantile(double q) const {
+        uint64_t rank = std::max<uint64_t>(1, (uint64_t)(q * (double)count + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            seen += buckets[i];
+            if (seen >= rank) {
+                return std::min(bucketValue(i), max);
+            }
+        }
+        return max;
+    }
+};
+
+// Copies what the registry and shards hold now, so formatting runs without the lock;
+// metrics come out sorted by name, labels in registration order
+void collect(std::vector<Metric>& metrics, std::vector<int64_t>& values, std::vector<Merged>& histograms) {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    metrics = reg.metrics;
+    std::stable_sort(metrics.begin(), metrics.end(), [](const Metric& a, const Metric& b) { return a.name < b.name; });
+    values.assign(reg.values, 0);
+    histograms.assign(reg.histograms, Merged());
+    for (const Shard* shard : reg.shards) {
+        for (size_t i = 0; i < reg.values; ++i) {
+            values[i] += shard->values[i].load(std::memory_order_relaxed);
+        }
+        for (size_t h = 0; h < reg.histograms; ++h) {
+            const HistogramShard* part = shard->histograms[h].load(std::memory_order_acquire);
+            if (part == nullptr) {
+                continue;
+            }
+            Merged& merged = histograms[h];
+            for (size_t i = 0; i < BUCKETS; ++i) {
+                merged.buckets[i] += part->buckets[i].load(std::memory_order_relaxed);
+            }
+            merged.count += part->count.load(std::memory_order_relaxed);
+            merged.sum += part->sum.load(std::memory_order_relaxed);
+            merged.max = std::max(merged.max, part->max.load(std::memory_order_relaxed));
+        }
+    }
+}
+
+void writeName(ReplyWriter& writer, const Metric& metric, const char* suffix, const std::string& extra) {
+    writer << metric.name << suffix;
+    if (!metric.labels.empty() || !extra.empty()) {
+        writer << '{' << metric.labels << (metric.labels.empty() || extra.empty() ? "" : ",") << extra << '}';
+    }
+}
+
+double seconds(uint64_t nanoseconds) {
+    return (double)nanoseconds / 1e9;
+}
+
+} // namespace
+
+Stats::Id Stats::counter(const std::string& name, const std::string& labels) {
+    return registerMetric(name, labels, Kind::COUNTER);
+}
+
+Stats::Id Stats::gauge(const std::string& name, const std::string& labels) {
+    return registerMetric(name, labels, Kind::GAUGE);
+}
+
+Stats::Id Stats::histogram(const std::string& name, const std::string& labels) {
+    return registerMetric(name, labels, Kind::HISTOGRAM);
+}
+
+void Stats::add(Id metric, int64_t delta) {
+    bump(localShard().values[metric], delta);
+}
+
+void Stats::record(Id histogram, uint64_t nanoseconds) {
+    std::atomic<HistogramShard*>& slot = localShard().histograms[histogram];
+    HistogramShard* part = slot.load(std::memory_order_relaxed);
+    if (part == nullptr) {
+        part = new HistogramShard();
+        slot.store(part, std::memory_order_release);
+    }
+    bump(part->buckets[bucketOf(nanoseconds)], uint64_t(1));
+    bump(part->count, uint64_t(1));
+    bump(part->sum, nanoseconds);
+    if (nanoseconds > part->max.load(std::memory_order_relaxed)) {
+        part->max.store(nanoseconds, std::memory_order_relaxed);
+    }
+}
+
+void Stats::writeText(std::string& out) {
+    std::vector<Metric> metrics;
+    std::vector<int64_t> values;
+    std::vector<Merged> histograms;
+    collect(metrics, values, histograms);
+    ReplyWriter writer(out);
+    for (const Metric& metric : metrics) {
+        if (metric.kind != Kind::HISTOGRAM) {
+            writeName(writer, metric, "", "");
+            writer << ' ' << values[metric.slot] << '\n';
+            continue;
+        }
+        // Histograms nothing was recorded into yet are left out; microseconds read better than seconds here
+        const Merged& merged = histograms[metric.slot];
+        if (merged.count > 0) {
+            writeName(writer, metric, "", "");
+            writer << " count=" << merged.count << " mean=" << (double)merged.sum / (double)merged.count / 1e3 << "us";
+            for (double q : QUANTILES) {
+                writer << " p" << q * 100 << '=' << (double)merged.quantile(q) / 1e3 << "us";
+            }
+            writer << " max=" << (double)merged.max / 1e3 << "us\n";
+        }
+    }
+}
+
+void Stats::writePrometheus(std::string& out) {
+    std::vector<Metric> metrics;
+    std::vector<int64_t> values;
+    std::vector<Merged> histograms;
+    collect(metrics, values, histograms);
+    ReplyWriter writer(out);
+    std::string typed;  // Metrics sharing a name are adjacent and get a single TYPE line
+    for (const Metric& metric : metrics) {
+        if (metric.name != typed) {
+            const char* type = metric.kind == Kind::COUNTER ? "counter" : metric.kind == Kind::GAUGE ? "gauge" : "summary";
+            writer << "# TYPE " << metric.name << ' ' << type << '\n';
+            typed = metric.name;
+        }
+        if (metric.kind != Kind::HISTOGRAM) {
+            writeName(writer, metric, "", "");
+            writer << ' ' << values[metric.slot] << '\n';
+            continue;
+        }
+        const Merged& merged = histograms[metric.slot];
+        for (double q : QUANTILES) {
+            std::string quantile;
+            ReplyWriter(quantile) << "quantile=\"" << q << '"';
+            writeName(writer, metric, "", quantile);
+            writer << ' ' << (merged.count > 0 ? seconds(merged.quantile(q)) : 0.0) << '\n';
+        }
+        writeName(writer, metric, "_sum", "");
+        writer << ' ' << seconds(merged.sum) << '\n';
+        writeName(writer, metric, "_count", "");
+        writer << ' ' << merged.count << '\n';
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <string>
+#include <cstdint>
+#include <chrono>
+
+/* Process-wide counters, gauges and latency histograms.
+Every thread records into its own shard, so recording is a few plain loads and stores
+to memory no other thread writes: no lock, no atomic read-modify-write, no shared cache
+line. Readers (the stats command, the admin port) sum the shards; a value being updated
+meanwhile is either counted or not, never torn.
+
+Histograms are log-linear like HdrHistogram's: 16 buckets per power of two, so any
+recorded value is known within 1/16 of itself, from 1 ns to centuries, in ~8 KB per
+histogram and thread (allocated on a thread's first record into it).
+
+Metrics are registered once, usually into a static, and then referred to by Id:
+    static const Stats::Id sendTime = Stats::histogram("send_seconds", "server=\"reactor\"");
+    Stats::record(sendTime, nanoseconds);
+*/
+class Stats {
+public:
+    using Id = uint32_t;
+
+    // Registers a metric, or finds the one already registered with this name and labels.
+    // labels is the inside of Prometheus braces, e.g. command="MST" (empty for none)
+    static Id counter(const std::string& name, const std::string& labels = "");
+    static Id gauge(const std::string& name, const std::string& labels = "");
+    // Latencies in nanoseconds, reported in seconds
+    static Id histogram(const std::string& name, const std::string& labels = "");
+
+    static void add(Id metric, int64_t delta = 1);  // Counters and gauges
+    static void record(Id histogram, uint64_t nanoseconds);
+
+    // Monotonic clock for the durations recorded here
+    static uint64_t now() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // The stats command: one line per metric, histograms with count, mean and percentiles
+    static void writeText(std::string& out);
+    // Prometheus text exposition format; histograms as summaries
+    static void writePrometheus(std::string& out);
+};
+
+// Records the time from its construction to its destruction
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Stats::Id histogram) : histogram_(histogram), start_(Stats::now()) {}
+    ~ScopedTimer() { Stats::record(histogram_, Stats::now() - start_); }
+
+private:
+    Stats::Id histogram_;
+    uint64_t start_;
+};
+
+#endif // STATS_HPP
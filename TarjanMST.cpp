@@ -1,4 +1,5 @@
 #include "TarjanMST.hpp"
+#include "Trace.hpp"
 #include "Graph.hpp" // Include Graph header if not included elsewhere
 #include <algorithm> // Include for std::sort
 #include <vector>
@@ -18,23 +19,30 @@ void TarjanMST::DFS(const Graph& graph, int u, std::vector<bool>& visited, std::
 }
 
 Tree TarjanMST::computeMST(const Graph& graph) {
+    TRACE_SPAN("tarjan");
     size_t V = (size_t)graph.getVertices();
     Tree mst(V); // Initialize an empty Tree for MST
     std::vector<bool> visited(V, false);
     std::stack<Edge> edges;
 
     // Start DFS from vertex 0 (assuming graph is connected)
-    DFS(graph, 0, visited, edges);
+    {
+        TRACE_SPAN("tarjan.dfs");
+        DFS(graph, 0, visited, edges);
+    }
 
     // Sort edges in increasing order on basis of cost
     std::vector<Edge> sortedEdges;
-    while (!edges.empty()) {
-        sortedEdges.push_back(edges.top());
-        edges.pop();
+    {
+        TRACE_SPAN("tarjan.sort");
+        while (!edges.empty()) {
+            sortedEdges.push_back(edges.top());
+            edges.pop();
+        }
+        std::sort(sortedEdges.begin(), sortedEdges.end(), [](const Edge& a, const Edge& b) {
+            return a.weight < b.weight;
+        });
     }
-    std::sort(sortedEdges.begin(), sortedEdges.end(), [](const Edge& a, const Edge& b) {
-        return a.weight < b.weight;
-    });
 
     // Union-Find data structure initialization
     std::vector<int> parent(V), rank(V);
@@ -44,19 +52,24 @@ Tree TarjanMST::computeMST(const Graph& graph) {
     }
 
     // Process sorted edges and add to MST using Union-Find
-    for (const Edge& edge : sortedEdges) {
-        size_t u = (size_t)edge.src;
-        size_t v = (size_t)edge.dest;
-        size_t set_u = (size_t)find(parent, u);
-        size_t set_v = (size_t)find(parent, v);
+    {
+        TRACE_SPAN("tarjan.union_find");  // Includes Tree::addEdge
+        for (const Edge& edge : sortedEdges) {
+            size_t u = (size_t)edge.src;
+            size_t v = (size_t)edge.dest;
+            size_t set_u = (size_t)find(parent, u);
+            size_t set_v = (size_t)find(parent, v);
 
-        // Check for cycle (ignore if both vertices are already in MST)
-        if (set_u != set_v) {
-            mst.addEdge(u, v, edge.weight);
-            Union(parent, rank, set_u, set_v);
+            // Check for cycle (ignore if both vertices are already in MST)
+            if (set_u != set_v) {
+                mst.addEdge(u, v, edge.weight);
+                Union(parent, rank, set_u, set_v);
+            }
         }
     }
 
+    mst.finalize();  // Pack into the CSR layout before the tree is shared
+
     return mst;
 }
 
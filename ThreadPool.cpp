@@ -0,0 +1,210 @@
+#include "ThreadPool.hpp"
+#include "CpuTopology.hpp"
+#include <utility>
+
+namespace {
+// Index of the calling thread's deque, or NOT_A_WORKER for threads outside the pool
+const size_t NOT_A_WORKER = static_cast<size_t>(-1);
+thread_local const WorkStealingPool* currentPool = nullptr;
+thread_local size_t currentIndex = NOT_A_WORKER;
+
+// Settings for WorkStealingPool::compute(), fixed once the pool is created
+std::mutex computeConfigMutex;
+bool computeCreated = false;
+size_t computeThreads = 0;  // 0 means availableCpus()
+std::vector<int> computeCpus;
+
+// Marks the compute() settings as final and returns its thread count
+size_t freezeComputeThreads() {
+    std::lock_guard<std::mutex> lock(computeConfigMutex);
+    computeCreated = true;
+    return computeThreads > 0 ? computeThreads : availableCpus();
+}
+}
+
+WorkStealingPool::WorkStealingPool(size_t threadCount, const std::vector<int>& cpus) {
+    for (size_t i = 0; i < threadCount; ++i) {
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+    for (size_t i = 0; i < threadCount; ++i) {
+        int cpu = i < cpus.size() ? cpus[i] : -1;
+        threads.emplace_back([this, i, cpu]() {
+            if (cpu >= 0) {
+                pinCurrentThread(cpu);
+            }
+            workerLoop(i);
+        });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stop = true;
+    }
+    sleepCondition.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+WorkStealingPool& WorkStealingPool::compute() {
+    static WorkStealingPool pool(freezeComputeThreads(), computeCpus);
+    return pool;
+}
+
+bool WorkStealingPool::configureCompute(size_t threadCount, const std::vector<int>& cpus) {
+    std::lock_guard<std::mutex> lock(computeConfigMutex);
+    if (computeCreated) {
+        return false;
+    }
+    computeThreads = threadCount;
+    computeCpus = cpus;
+    return true;
+}
+
+void WorkStealingPool::submit(Task task, const void* group) {
+    if (queues.empty()) {
+        task();  // No workers: run inline
+        return;
+    }
+    // Workers keep their own forks local; everyone else spreads work round-robin
+    size_t index = currentPool == this ? currentIndex : nextQueue++ % queues.size();
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(Entry{std::move(task), group});
+    }
+    queued++;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    sleepCondition.notify_one();
+}
+
+bool WorkStealingPool::popLocal(size_t index, Task& task) {
+    std::lock_guard<std::mutex> lock(queues[index]->mutex);
+    if (queues[index]->tasks.empty()) {
+        return false;
+    }
+    task = std::move(queues[index]->tasks.back().task);
+    queues[index]->tasks.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::steal(size_t thief, Task& task) {
+    const size_t count = queues.size();
+    size_t start = thief == NOT_A_WORKER ? 0 : thief + 1;
+    for (size_t i = 0; i < count; ++i) {
+        size_t victim = (start + i) % count;
+        if (victim == thief) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(queues[victim]->mutex, std::try_to_lock);
+        if (!lock.owns_lock() || queues[victim]->tasks.empty()) {
+            continue;
+        }
+        task = std::move(queues[victim]->tasks.front().task);
+        queues[victim]->tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+// The newest of group's tasks in one deque. The lock is waited for: skipping a busy deque
+// could leave the group's last task queued while its waiter goes to sleep
+bool WorkStealingPool::takeFromGroup(size_t index, const void* group, Task& task) {
+    std::lock_guard<std::mutex> lock(queues[index]->mutex);
+    std::deque<Entry>& tasks = queues[index]->tasks;
+    for (auto it = tasks.rbegin(); it != tasks.rend(); ++it) {
+        if (it->group == group) {
+            task = std::move(it->task);
+            tasks.erase(std::next(it).base());
+            return true;
+        }
+    }
+    return false;
+}
+
+bool WorkStealingPool::runPendingTask(const void* group) {
+    if (queued.load() == 0) {
+        return false;
+    }
+    size_t index = currentPool == this ? currentIndex : NOT_A_WORKER;
+    Task task;
+    bool found = false;
+    if (group != nullptr) {
+        // The group's forks usually sit in the waiter's own deque; look there first
+        for (size_t i = 0; i < queues.size() && !found; ++i) {
+            found = takeFromGroup(index == NOT_A_WORKER ? i : (index + i) % queues.size(), group, task);
+        }
+    } else {
+        found = (index != NOT_A_WORKER && popLocal(index, task)) || steal(index, task);
+    }
+    if (found) {
+        queued--;
+        task();
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::workerLoop(size_t index) {
+    currentPool = this;
+    currentIndex = index;
+    while (true) {
+        if (runPendingTask()) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepCondition.wait(lock, [this] { return stop || queued.load() > 0; });
+        if (stop && queued.load() == 0) {
+            return;
+        }
+    }
+}
+
+TaskGroup::~TaskGroup() {
+    // Never leave forked tasks pointing at a destroyed group
+    join();
+}
+
+void TaskGroup::run(WorkStealingPool::Task task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending++;
+    }
+    pool.submit([this, task = std::move(task)]() {
+        std::exception_ptr thrown;
+        try {
+            task();
+        } catch (...) {
+            thrown = std::current_exception();
+        }
+        // Notified under the lock: once the waiter sees pending == 0 nothing here touches the group
+        std::lock_guard<std::mutex> lock(mutex);
+        if (thrown && !error) {
+            error = thrown;
+        }
+        if (--pending == 0) {
+            finished.notify_all();
+        }
+    }, this);
+}
+
+// Runs the group's queued tasks here, then sleeps until the ones other threads took are done
+void TaskGroup::join() {
+    while (pool.runPendingTask(this)) {
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return pending == 0; });
+}
+
+void TaskGroup::wait() {
+    join();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (error) {
+        std::exception_ptr rethrow = error;
+        error = nullptr;
+        std::rethrow_exception(rethrow);
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+
+/* Work-stealing thread pool.
+Every worker owns a deque: it pushes and pops its own tasks at the back (LIFO, cache
+warm) while idle workers steal from the front of other deques (FIFO, oldest and usually
+largest pieces of work). Tasks submitted from outside the pool are spread round-robin.
+A thread that waits on a TaskGroup runs the group's own queued tasks until none are left,
+so fork-join inside a task never deadlocks, whatever the pool size; it then sleeps until
+the ones other threads took have finished. It never picks up unrelated work (another
+client's command batch) while it waits: that would delay the group behind it and nest
+without bound on the waiter's stack.
+*/
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    // Worker i is pinned to cpus[i] when cpus is not empty
+    explicit WorkStealingPool(size_t threadCount, const std::vector<int>& cpus = {});
+    ~WorkStealingPool();
+
+    // group tags the task so that its TaskGroup can find it; nullptr for standalone tasks
+    void submit(Task task, const void* group = nullptr);
+    // Runs one queued task on the calling thread, only one of group's when group is set;
+    // false if there was none
+    bool runPendingTask(const void* group = nullptr);
+    size_t size() const { return threads.size(); }
+
+    // Shared pool for compute kernels (tree metrics, parallel MST phases)
+    static WorkStealingPool& compute();
+    // Sets the size and pinning of compute(); only effective before its first use
+    static bool configureCompute(size_t threadCount, const std::vector<int>& cpus);
+
+private:
+    struct Entry {
+        Task task;
+        const void* group;
+    };
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Entry> tasks;
+    };
+
+    void workerLoop(size_t index);
+    bool popLocal(size_t index, Task& task);
+    bool steal(size_t thief, Task& task);
+    bool takeFromGroup(size_t index, const void* group, Task& task);
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> queued{0};
+    std::atomic<size_t> nextQueue{0};
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    bool stop = false;
+};
+
+// A set of forked tasks that can be joined; wait() helps instead of blocking
+class TaskGroup {
+public:
+    explicit TaskGroup(WorkStealingPool& pool) : pool(pool) {}
+    ~TaskGroup();
+
+    void run(WorkStealingPool::Task task);
+    // Returns once every task in the group has finished; rethrows the first exception
+    void wait();
+
+private:
+    void join();
+
+    WorkStealingPool& pool;
+    std::mutex mutex;  // Guards pending and error
+    std::condition_variable finished;
+    size_t pending = 0;
+    std::exception_ptr error;
+};
+
+// Calls body(b, e) over [begin, end) split into pieces of at most grain elements
+template <typename Body>
+void parallelFor(WorkStealingPool& pool, size_t begin, size_t end, size_t grain, const Body& body) {
+    if (end - begin <= grain || pool.size() < 2) {
+        body(begin, end);
+        return;
+    }
+    size_t mid = begin + (end - begin) / 2;
+    TaskGroup group(pool);
+    group.run([&pool, mid, end, grain, &body]() {
+        parallelFor(pool, mid, end, grain, body);
+    });
+    parallelFor(pool, begin, mid, grain, body);
+    group.wait();
+}
+
+/* Reduces [begin, end): map(b, e) produces a partial result for a piece of at most
+grain elements and combine(left, right) merges neighbouring pieces. Pieces are always
+combined in index order, so the result does not depend on which thread ran what.
+*/
+template <typename T, typename Map, typename Combine>
+T parallelReduce(WorkStealingPool& pool, size_t begin, size_t end, size_t grain, const Map& map, const Combine& combine) {
+    if (end - begin <= grain || pool.size() < 2) {
+        return map(begin, end);
+    }
+    size_t mid = begin + (end - begin) / 2;
+    T right;
+    TaskGroup group(pool);
+    group.run([&pool, &right, mid, end, grain, &map, &combine]() {
+        right = parallelReduce<T>(pool, mid, end, grain, map, combine);
+    });
+    T left = parallelReduce<T>(pool, begin, mid, grain, map, combine);
+    group.wait();
+    return combine(left, right);
+}
+
+#endif // THREADPOOL_HPP
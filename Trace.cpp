@@ -0,0 +1,109 @@
+#include "Trace.hpp"
+#include "ReplyWriter.hpp"
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+namespace {
+
+const size_t BUFFER_EVENTS = 1 << 16;  // Per thread; about 1.5 MB once the thread traces
+
+// Written by its thread only; the fields are atomic so an export can read them meanwhile
+struct Event {
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> start{0};
+    std::atomic<uint64_t> cycles{0};
+};
+
+struct Buffer {
+    uint32_t thread;
+    std::vector<Event> events = std::vector<Event>(BUFFER_EVENTS);
+    std::atomic<uint64_t> written{0};  // Events ever recorded; the latest are at written - 1 (mod size)
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<Buffer*> buffers;  // Never freed, so a thread's spans outlive it
+    uint64_t originCycles = Trace::cycles();
+    std::chrono::steady_clock::time_point originTime = std::chrono::steady_clock::now();
+    uint64_t clearedAt = 0;  // Events that started before are not exported
+};
+
+Registry& registry() {
+    static Registry* instance = new Registry();
+    return *instance;
+}
+
+// Made during static initialization, so the clock origin precedes every span
+Registry& origin = registry();
+
+Buffer& localBuffer() {
+    thread_local Buffer* buffer = nullptr;
+    if (buffer == nullptr) {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        buffer = new Buffer();
+        buffer->thread = (uint32_t)reg.buffers.size() + 1;
+        reg.buffers.push_back(buffer);
+    }
+    return *buffer;
+}
+
+// Counter ticks per microsecond, measured over the time since the registry was made
+double ticksPerMicrosecond(const Registry& reg) {
+    auto elapsed = std::chrono::steady_clock::now() - reg.originTime;
+    if (elapsed < std::chrono::milliseconds(10)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10) - elapsed);
+    }
+    uint64_t ticks = Trace::cycles() - reg.originCycles;
+    double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - reg.originTime).count();
+    return std::max(1e-9, (double)ticks / micros);
+}
+
+} // namespace
+
+void Trace::record(const char* name, uint64_t start, uint64_t end) {
+    Buffer& buffer = localBuffer();
+    uint64_t index = buffer.written.load(std::memory_order_relaxed);
+    Event& event = buffer.events[index & (BUFFER_EVENTS - 1)];
+    event.name.store(name, std::memory_order_relaxed);
+    event.start.store(start, std::memory_order_relaxed);
+    event.cycles.store(end - start, std::memory_order_relaxed);
+    buffer.written.store(index + 1, std::memory_order_release);
+}
+
+void Trace::clear() {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.clearedAt = cycles();
+}
+
+void Trace::writeChromeJson(std::string& out) {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    double rate = ticksPerMicrosecond(reg);
+    ReplyWriter writer(out);
+    writer << "{\"traceEvents\":[";
+    bool first = true;
+    for (const Buffer* buffer : reg.buffers) {
+        uint64_t written = buffer->written.load(std::memory_order_acquire);
+        uint64_t begin = written > BUFFER_EVENTS ? written - BUFFER_EVENTS : 0;
+        for (uint64_t i = begin; i < written; ++i) {
+            const Event& event = buffer->events[i & (BUFFER_EVENTS - 1)];
+            uint64_t start = event.start.load(std::memory_order_relaxed);
+            if (start < reg.clearedAt) {
+                continue;
+            }
+            uint64_t ticks = event.cycles.load(std::memory_order_relaxed);
+            writer << (first ? "" : ",") << "\n{\"name\":\"" << event.name.load(std::memory_order_relaxed)
+                   << "\",\"cat\":\"mst\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread
+                   << ",\"ts\":" << ReplyWriter::fixed((double)(start - reg.originCycles) / rate)
+                   << ",\"dur\":" << ReplyWriter::fixed((double)ticks / rate)
+                   << ",\"args\":{\"cycles\":" << ticks << "}}";
+            first = false;
+        }
+    }
+    writer << "\n]}";
+}
@@ -0,0 +1,74 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <string>
+#include <cstdint>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* Phase-level trace spans for the MST algorithms and the metrics.
+TRACE_SPAN("kruskal.sort") times the rest of the enclosing scope as one phase. Spans are
+only compiled in with -DMST_TRACE (make TRACE=1); otherwise the macro expands to nothing,
+so the kernels carry no trace code at all.
+A span reads the cycle counter on entry and exit and appends {name, start, cycles} to a
+buffer owned by its thread: no lock, no allocation after the thread's first span, nothing
+shared with other threads. A full buffer wraps around and keeps the most recent events.
+writeChromeJson() exports the buffers of every thread in the Chrome trace event format
+(load it in chrome://tracing or Perfetto), with cycles converted to microseconds at a
+rate measured against the steady clock.
+*/
+class Trace {
+public:
+#ifdef MST_TRACE
+    static constexpr bool ENABLED = true;
+#else
+    static constexpr bool ENABLED = false;
+#endif
+
+    // Appends {"traceEvents":[...]}; the list is empty when tracing is compiled out
+    static void writeChromeJson(std::string& out);
+    // Later exports start from now
+    static void clear();
+
+    // Timestamp counter: TSC cycles on x86, steady clock nanoseconds elsewhere
+    static uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    // name must outlive the trace (a string literal)
+    static void record(const char* name, uint64_t start, uint64_t end);
+};
+
+#ifdef MST_TRACE
+
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name) : name_(name), start_(Trace::cycles()) {}
+    ~TraceSpan() { Trace::record(name_, start_, Trace::cycles()); }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name_;
+    uint64_t start_;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SPAN(name) TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(name)
+
+#else
+
+#define TRACE_SPAN(name) static_cast<void>(0)
+
+#endif // MST_TRACE
+
+#endif // TRACE_HPP
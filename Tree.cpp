@@ -1,246 +1,357 @@
 #include "Tree.hpp"
+#include "ThreadPool.hpp"
+#include "ReplyWriter.hpp"
+#include "Trace.hpp"
 #include <utility>  // for std::move
+#include <algorithm>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
-/* Creates threadCount worker threads and assigns each one the responsibility to 
-execute the workerThread function.
-*/
-LeaderFollower::LeaderFollower(size_t threadCount) {
-    for (size_t i = 0; i < threadCount; ++i) {
-        // workerThread = It defines the behavior of each individual thread in the thread pool.
-        workers.emplace_back(&LeaderFollower::workerThread, this);
+// Tree class implementation
+Tree::Tree(int myVertices) : Tree(static_cast<size_t>(myVertices)) {}
+
+Tree::Tree(size_t n) : vertices(n) {
+    if (n >= NO_PARENT) {
+        throw std::length_error("Tree: too many vertices");
     }
+    childOffset_.assign(n + 1, 0);
+    parent_.assign(n, NO_PARENT);
+    parentEdge_.assign(n, NO_PARENT);
 }
 
-/*Signals the workers to stop by setting stop = true and notifying all threads.
-Ensures that all threads finish by calling join() on them (so the main thread waits for all 
-workers to finish their tasks and terminate before destruction).
-*/
-LeaderFollower::~LeaderFollower() {
-    {
-        std::unique_lock<std::mutex> lock(tasksMutex);
-        stop = true;
-    }
-    tasksCondition.notify_all();
-    for (auto& worker : workers) {
-        if (worker.joinable()) {
-            worker.join();
-        }
-    }
+Tree::Tree() : Tree(static_cast<size_t>(0)) {}
+
+bool Tree::isValid() const {
+    return vertices > 0;
 }
 
-/* responsible for adding a new task to the task queue and notifying the worker 
-threads that a task is available for execution.
-*/
-std::future<void> LeaderFollower::submitTask(Task task) {
-    // Wrap the task in a std::packaged_task
-    auto packagedTask = std::make_shared<std::packaged_task<void()>>(std::move(task));
-    std::future<void> result = packagedTask->get_future();
+void Tree::addEdge(size_t u, size_t v) {
+    addEdge(u, v, 0.0); // Default weight 0.0
+}
 
-    {
-        // Lock the task queue before pushing
-        std::unique_lock<std::mutex> lock(tasksMutex);
+void Tree::printTree() const {
+    printTree(std::cout);
+}
 
-        // Push the task into the queue
-        tasks.push([packagedTask]() {
-            (*packagedTask)();  // Dereference and call the packaged task
-        });
+void Tree::printTree(std::ostream& os) const {
+    std::string out;
+    printTree(out);
+    os.write(out.data(), static_cast<std::streamsize>(out.size()));  // One write, instead of a flush per line
+}
+
+// Lists each vertex's neighbors in the order their edges were added, as the adjacency-list
+// Tree did, so the text replies do not depend on how the tree is rooted
+void Tree::printTree(std::string& out) const {
+    ensureFinalized();
+    ReplyWriter writer(out);
+    std::vector<uint32_t> slots;
+    for (size_t i = 0; i < vertices; ++i) {
+        slots.clear();
+        if (parent_[i] != NO_PARENT) {
+            slots.push_back(parentEdge_[i]);
+        }
+        for (uint32_t slot = childOffset_[i]; slot < childOffset_[i + 1]; ++slot) {
+            slots.push_back(slot);
+        }
+        std::sort(slots.begin(), slots.end(), [this](uint32_t a, uint32_t b) { return rank_[a] < rank_[b]; });
+        writer << i << " -> ";
+        for (uint32_t slot : slots) {
+            size_t neighbor = slot == parentEdge_[i] ? parent_[i] : children_[slot];
+            writer << '(' << neighbor << ", " << weights_[slot] << ") ";
+        }
+        writer << '\n';
     }
+}
 
-    // Notify one waiting thread that a new task is available
-    tasksCondition.notify_one();
+void Tree::addEdge(size_t u, size_t v, double weight) {
+    if (u >= vertices || v >= vertices) {
+        throw std::out_of_range("Tree::addEdge: vertex out of range");
+    }
+    // Only recorded here; the packed arrays are rebuilt by finalize()
+    pending_.push_back(TreeEdge{static_cast<uint32_t>(u), static_cast<uint32_t>(v), weight});
+}
+
+void Tree::finalize() {
+    ensureFinalized();
+}
 
-    return result;
+void Tree::ensureFinalized() const {
+    if (!pending_.empty()) {
+        build();
+    }
 }
 
+/* Packs every edge into the parent / child-offset arrays. Each component is rooted at
+its smallest vertex and explored breadth first over a temporary undirected CSR index,
+which is released once the tree arrays are filled in.
+*/
+void Tree::build() const {
+    TRACE_SPAN("tree.finalize");
+    std::vector<TreeEdge> edges;
+    std::vector<uint32_t> edgeRank;  // Position of each edge in addEdge() order
+    edges.reserve(children_.size() + pending_.size());
+    edgeRank.reserve(children_.size() + pending_.size());
+    for (size_t p = 0; p < vertices; ++p) {
+        for (uint32_t slot = childOffset_[p]; slot < childOffset_[p + 1]; ++slot) {
+            edges.push_back(TreeEdge{static_cast<uint32_t>(p), children_[slot], weights_[slot]});
+            edgeRank.push_back(rank_[slot]);
+        }
+    }
+    edges.insert(edges.end(), pending_.begin(), pending_.end());
+    for (size_t i = 0; i < pending_.size(); ++i) {
+        edgeRank.push_back(static_cast<uint32_t>(children_.size() + i));
+    }
 
-void LeaderFollower::workerThread() {
-    while (true) { // waiting for a task to be added to the task queue.
-        Task task;
-        {
-            std::unique_lock<std::mutex> lock(tasksMutex);
+    // Temporary undirected adjacency: incident edge ids of v are incident[adjOffset[v] .. adjOffset[v+1])
+    std::vector<uint32_t> adjOffset(vertices + 1, 0);
+    for (const TreeEdge& e : edges) {
+        ++adjOffset[e.u + 1];
+        ++adjOffset[e.v + 1];
+    }
+    for (size_t v = 0; v < vertices; ++v) {
+        adjOffset[v + 1] += adjOffset[v];
+    }
+    std::vector<uint32_t> incident(2 * edges.size());
+    {
+        std::vector<uint32_t> cursor(adjOffset.begin(), adjOffset.end() - 1);
+        for (size_t id = 0; id < edges.size(); ++id) {
+            incident[cursor[edges[id].u]++] = static_cast<uint32_t>(id);
+            incident[cursor[edges[id].v]++] = static_cast<uint32_t>(id);
+        }
+    }
 
-            /* Pause the thread until a task is available in the queue or until 
-            the stop signal is sent. */
-            tasksCondition.wait(lock, [this] { return stop || !tasks.empty(); });
-            if (stop && tasks.empty()) {
-                return;
+    // Breadth-first rooting; viaEdge[v] is the id of the edge from parent[v] to v
+    std::vector<uint32_t> parent(vertices, NO_PARENT);
+    std::vector<uint32_t> viaEdge(vertices, NO_PARENT);
+    std::vector<bool> visited(vertices, false);
+    std::vector<uint32_t> order;
+    order.reserve(vertices);
+    for (size_t root = 0; root < vertices; ++root) {
+        if (visited[root]) {
+            continue;
+        }
+        visited[root] = true;
+        order.push_back(static_cast<uint32_t>(root));
+        for (size_t head = order.size() - 1; head < order.size(); ++head) {
+            uint32_t x = order[head];
+            for (uint32_t k = adjOffset[x]; k < adjOffset[x + 1]; ++k) {
+                uint32_t id = incident[k];
+                if (id == viaEdge[x]) {
+                    continue;
+                }
+                uint32_t y = edges[id].u == x ? edges[id].v : edges[id].u;
+                if (visited[y]) {
+                    throw std::logic_error("Tree: edges do not form a forest");
+                }
+                visited[y] = true;
+                parent[y] = x;
+                viaEdge[y] = id;
+                order.push_back(y);
             }
-            task = std::move(tasks.front());
-            tasks.pop();
         }
-        task();  // Execute the task
     }
-}
 
-// Tree class implementation
-Tree::Tree(int myVertices) : vertices(myVertices) {
-    treeAdjList.resize(static_cast<size_t>(myVertices));
-}
+    // Group the children of every vertex into one contiguous run
+    std::vector<uint32_t> childOffset(vertices + 1, 0);
+    for (size_t v = 0; v < vertices; ++v) {
+        if (parent[v] != NO_PARENT) {
+            ++childOffset[parent[v] + 1];
+        }
+    }
+    for (size_t v = 0; v < vertices; ++v) {
+        childOffset[v + 1] += childOffset[v];
+    }
+    std::vector<uint32_t> children(edges.size());
+    std::vector<double> weights(edges.size());
+    std::vector<uint32_t> rank(edges.size());
+    std::vector<uint32_t> parentEdge(vertices, NO_PARENT);
+    std::vector<uint32_t> cursor(childOffset.begin(), childOffset.end() - 1);
+    for (size_t v = 0; v < vertices; ++v) {
+        if (parent[v] != NO_PARENT) {
+            uint32_t slot = cursor[parent[v]]++;
+            children[slot] = static_cast<uint32_t>(v);
+            weights[slot] = edges[viaEdge[v]].weight;
+            rank[slot] = edgeRank[viaEdge[v]];
+            parentEdge[v] = slot;
+        }
+    }
 
-Tree::Tree() {
-    treeAdjList.resize(static_cast<size_t>(0));
+    parent_.swap(parent);
+    parentEdge_.swap(parentEdge);
+    childOffset_.swap(childOffset);
+    children_.swap(children);
+    weights_.swap(weights);
+    rank_.swap(rank);
+    std::vector<TreeEdge>().swap(pending_);
 }
 
-bool Tree::isValid() const {
-    return !treeAdjList.empty();
+Tree::NeighborIterator::value_type Tree::NeighborIterator::operator*() const {
+    size_t pos = pos_;
+    if (tree_->parent_[vertex_] != NO_PARENT) {
+        if (pos == 0) {
+            return value_type(tree_->parent_[vertex_], tree_->weights_[tree_->parentEdge_[vertex_]]);
+        }
+        --pos;
+    }
+    size_t slot = tree_->childOffset_[vertex_] + pos;
+    return value_type(tree_->children_[slot], tree_->weights_[slot]);
 }
 
-void Tree::addEdge(size_t u, size_t v) {
-    treeAdjList[u].emplace_back(v, 0.0); // Default weight 0.0
-    treeAdjList[v].emplace_back(u, 0.0); // Assuming an undirected tree
+Tree::NeighborRange Tree::neighbors(size_t u) const {
+    ensureFinalized();
+    size_t count = childOffset_[u + 1] - childOffset_[u];
+    if (parent_[u] != NO_PARENT) {
+        ++count;
+    }
+    return NeighborRange(this, u, count);
 }
 
-void Tree::printTree() const {
-    for (size_t i = 0; i < treeAdjList.size(); ++i) {
-        std::cout << i << " -> ";
-        for (const auto& neighbor : treeAdjList[i]) {
-            std::cout << "(" << neighbor.first << ", " << neighbor.second << ") ";
-        }
-        std::cout << std::endl;
-    }
+size_t Tree::parent(size_t v) const {
+    ensureFinalized();
+    return parent_[v];
 }
 
-void Tree::printTree(std::ostream& os) const {
-    for (size_t i = 0; i < treeAdjList.size(); ++i) {
-        os << i << " -> ";
-        for (const auto& neighbor : treeAdjList[i]) {
-            os << "(" << neighbor.first << ", " << neighbor.second << ") ";
-        }
-        os << std::endl;
+double Tree::parentWeight(size_t v) const {
+    ensureFinalized();
+    if (parent_[v] == NO_PARENT) {
+        throw std::out_of_range("Tree::parentWeight: vertex is a root");
     }
+    return weights_[parentEdge_[v]];
 }
 
-void Tree::addEdge(size_t u, size_t v, double weight) {
-    treeAdjList[u].emplace_back(v, weight);
-    treeAdjList[v].emplace_back(u, weight); // Since the tree is undirected
+const std::vector<double>& Tree::edgeWeights() const {
+    ensureFinalized();
+    return weights_;
 }
 
-double Tree::calculateTotalWeight() const {
-    LeaderFollower lf(4);  // Create LF with 4 worker threads
+namespace {
 
-    double totalWeight = 0.0;
-    std::mutex weightMutex;
+// Partial result of the metrics kernel over one chunk of the weight array
+struct MetricsPartial {
+    double sum = 0.0;
+    double max = 0.0;
+    double min = std::numeric_limits<double>::max();
+};
 
-    std::vector<std::future<void>> futures;
-    for (const auto& neighbors : treeAdjList) {
-        futures.push_back(lf.submitTask([&]() {
-            double localWeight = 0.0;
-            for (const auto& neighbor : neighbors) {
-                localWeight += neighbor.second;
-            }
-            std::lock_guard<std::mutex> guard(weightMutex);
-            totalWeight += localWeight;
-        }));
-    }
+// Below this many edges a single thread is faster than any handoff to the pool
+const size_t kParallelMetricsThreshold = 1 << 16;
 
-    for (auto& future : futures) {
-        future.get();
+/* Computes sum, max and min of w[0..n) in one pass. Four independent accumulators
+(two SSE2 registers of two lanes each) hide the latency of the add/min/max chains.
+*/
+MetricsPartial reduceWeights(const double* w, size_t n) {
+    MetricsPartial out;
+    size_t i = 0;
+#if defined(__SSE2__)
+    __m128d sum0 = _mm_setzero_pd(), sum1 = _mm_setzero_pd();
+    __m128d max0 = _mm_setzero_pd(), max1 = _mm_setzero_pd();
+    __m128d min0 = _mm_set1_pd(out.min), min1 = _mm_set1_pd(out.min);
+    for (; i + 4 <= n; i += 4) {
+        __m128d a = _mm_loadu_pd(w + i);
+        __m128d b = _mm_loadu_pd(w + i + 2);
+        sum0 = _mm_add_pd(sum0, a);
+        sum1 = _mm_add_pd(sum1, b);
+        max0 = _mm_max_pd(max0, a);
+        max1 = _mm_max_pd(max1, b);
+        min0 = _mm_min_pd(min0, a);
+        min1 = _mm_min_pd(min1, b);
     }
-
-    return totalWeight / 2.0;
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(sum0, sum1));
+    out.sum = lanes[0] + lanes[1];
+    _mm_storeu_pd(lanes, _mm_max_pd(max0, max1));
+    out.max = std::max(lanes[0], lanes[1]);
+    _mm_storeu_pd(lanes, _mm_min_pd(min0, min1));
+    out.min = std::min(lanes[0], lanes[1]);
+#else
+    double sum[4] = {0.0, 0.0, 0.0, 0.0};
+    double max[4] = {0.0, 0.0, 0.0, 0.0};
+    double min[4] = {out.min, out.min, out.min, out.min};
+    for (; i + 4 <= n; i += 4) {
+        for (size_t lane = 0; lane < 4; ++lane) {
+            sum[lane] += w[i + lane];
+            max[lane] = std::max(max[lane], w[i + lane]);
+            min[lane] = std::min(min[lane], w[i + lane]);
+        }
+    }
+    out.sum = (sum[0] + sum[1]) + (sum[2] + sum[3]);
+    out.max = std::max(std::max(max[0], max[1]), std::max(max[2], max[3]));
+    out.min = std::min(std::min(min[0], min[1]), std::min(min[2], min[3]));
+#endif
+    // Scalar tail
+    for (; i < n; ++i) {
+        out.sum += w[i];
+        out.max = std::max(out.max, w[i]);
+        out.min = std::min(out.min, w[i]);
+    }
+    return out;
 }
 
-double Tree::calculateLongestDistance() const {
-    LeaderFollower lf(4);
-
-    double maxDistance = 0.0;
-    std::mutex maxMutex;
-
-    std::vector<std::future<void>> futures;
-    for (const auto& neighbors : treeAdjList) {
-        futures.push_back(lf.submitTask([&]() {
-            double localMax = 0.0;
-            for (const auto& neighbor : neighbors) {
-                if (neighbor.second > localMax) {
-                    localMax = neighbor.second;
-                }
-            }
-            std::lock_guard<std::mutex> guard(maxMutex);
-            if (localMax > maxDistance) {
-                maxDistance = localMax;
-            }
-        }));
-    }
+} // namespace
 
-    for (auto& future : futures) {
-        future.get();
+/* Computes every metric in a single scan of the packed weight array. Large trees are
+split recursively and the pieces reduced in parallel; partial results merge in order.
+*/
+TreeMetrics Tree::calculateMetrics() const {
+    TRACE_SPAN("metrics.all");
+    TreeMetrics metrics;
+    const std::vector<double>& weights = edgeWeights();
+    const size_t n = weights.size();
+    if (n == 0) {
+        return metrics;
     }
 
-    return maxDistance;
+    // Pieces of up to kParallelMetricsThreshold weights are reduced on the work-stealing pool
+    const double* w = weights.data();
+    MetricsPartial total = parallelReduce<MetricsPartial>(WorkStealingPool::compute(), 0, n, kParallelMetricsThreshold,
+        [w](size_t begin, size_t end) {
+            return reduceWeights(w + begin, end - begin);
+        },
+        [](const MetricsPartial& left, const MetricsPartial& right) {
+            MetricsPartial merged;
+            merged.sum = left.sum + right.sum;
+            merged.max = std::max(left.max, right.max);
+            merged.min = std::min(left.min, right.min);
+            return merged;
+        });
+
+    metrics.edgeCount = n;
+    metrics.totalWeight = total.sum;
+    metrics.longestDistance = total.max;
+    metrics.averageDistance = total.sum / static_cast<double>(n);
+    metrics.shortestDistance = total.min;
+    return metrics;
 }
 
-double Tree::calculateAverageDistance() const {
-    LeaderFollower lf(4);
-
-    double totalDistance = 0.0;
-    int edgeCount = 0;
-    std::mutex distMutex;
-
-    std::vector<std::future<void>> futures;
-    for (const auto& neighbors : treeAdjList) {
-        futures.push_back(lf.submitTask([&]() {
-            double localDistance = 0.0;
-            int localEdges = 0;
-            for (const auto& neighbor : neighbors) {
-                localDistance += neighbor.second;
-                ++localEdges;
-            }
-            std::lock_guard<std::mutex> guard(distMutex);
-            totalDistance += localDistance;
-            edgeCount += localEdges;
-        }));
-    }
+double Tree::calculateTotalWeight() const {
+    return calculateMetrics().totalWeight;
+}
 
-    for (auto& future : futures) {
-        future.get();
-    }
+double Tree::calculateLongestDistance() const {
+    return calculateMetrics().longestDistance;
+}
 
-    return edgeCount > 0 ? totalDistance / edgeCount : 0.0;
+double Tree::calculateAverageDistance() const {
+    return calculateMetrics().averageDistance;
 }
 
 double Tree::calculateShortestDistance() const {
-    LeaderFollower lf(4);
-
-    double minDistance = std::numeric_limits<double>::max();
-    std::mutex minMutex;
-
-    std::vector<std::future<void>> futures;
-    for (const auto& neighbors : treeAdjList) {
-        futures.push_back(lf.submitTask([&]() {
-            double localMin = std::numeric_limits<double>::max();
-            for (const auto& neighbor : neighbors) {
-                if (neighbor.second < localMin) {
-                    localMin = neighbor.second;
-                }
-            }
-            std::lock_guard<std::mutex> guard(minMutex);
-            if (localMin < minDistance) {
-                minDistance = localMin;
-            }
-        }));
-    }
-
-    for (auto& future : futures) {
-        future.get();
-    }
-
-    return minDistance;
+    return calculateMetrics().shortestDistance;
 }
 
 double Tree::getEdgeWeight(size_t u, size_t v) const {
-    for (const auto& neighbor : treeAdjList[u]) {
-        if (neighbor.first == v) {
-            return neighbor.second; // Return weight if edge found
-        }
+    ensureFinalized();
+    if (parent_[v] == u) {
+        return weights_[parentEdge_[v]];
+    }
+    if (parent_[u] == v) {
+        return weights_[parentEdge_[u]];
     }
     throw std::out_of_range("Edge not found"); // Throw exception if edge not found
 }
 
 int Tree::getEdgesCount() const {
-    int count = 0;
-    for (const auto& neighbors : treeAdjList) {
-        count += (int)neighbors.size();
-    }
-    // Each edge is counted twice, so divide by 2
-    return count / 2;
-}
\ No newline at end of file
+    // Every edge is stored once, either packed or still pending
+    return static_cast<int>(children_.size() + pending_.size());
+}
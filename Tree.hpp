@@ -2,52 +2,85 @@
 #define TREE_HPP
 
 #include <vector>
-#include <queue>
-#include <mutex>
-#include <condition_variable>
-#include <thread>
-#include <future>
 #include <iostream>
 #include <stdexcept>
 #include <limits>
 #include <functional>
+#include <cstdint>
+#include <utility>
+#include <string>
 
-// Leader-Follower class definition
-class LeaderFollower {
+// Aggregate statistics over the MST edges, produced by a single pass over the weights
+struct TreeMetrics {
+    double totalWeight = 0.0;
+    double longestDistance = 0.0;
+    double averageDistance = 0.0;
+    double shortestDistance = std::numeric_limits<double>::max();
+    size_t edgeCount = 0;
+};
+
+// One undirected tree edge, as handed out by Tree::forEachEdge
+struct TreeEdge {
+    uint32_t u, v;
+    double weight;
+};
+
+/* Tree class definition.
+Edges are collected into a flat list while the MST is being built. finalize() then
+roots every component and packs the tree into parent / parent-edge / child-offset
+arrays (a CSR layout), so each edge is stored once and no vertex owns an allocation.
+Readers finalize lazily, but that is not thread safe: the MST strategies call
+finalize() before returning so a finished Tree can be shared between threads.
+*/
+class Tree {
 public:
-    using Task = std::function<void()>;
+    static constexpr uint32_t NO_PARENT = std::numeric_limits<uint32_t>::max();
 
-    LeaderFollower(size_t threadCount);
-    ~LeaderFollower();
+    // Iterates the (neighbor, weight) pairs of one vertex: its parent first, then its children
+    class NeighborIterator {
+    public:
+        using value_type = std::pair<size_t, double>;
 
-    // Submits a task to the thread pool
-    std::future<void> submitTask(Task task);
+        NeighborIterator(const Tree* tree, size_t vertex, size_t pos) : tree_(tree), vertex_(vertex), pos_(pos) {}
+        value_type operator*() const;
+        NeighborIterator& operator++() { ++pos_; return *this; }
+        bool operator==(const NeighborIterator& other) const { return pos_ == other.pos_; }
+        bool operator!=(const NeighborIterator& other) const { return pos_ != other.pos_; }
 
-private:
-    void workerThread();  // Each worker thread will execute this function
+    private:
+        const Tree* tree_;
+        size_t vertex_;
+        size_t pos_;
+    };
 
-    std::queue<Task> tasks;
-    std::mutex tasksMutex;
-    std::condition_variable tasksCondition;
-    bool stop = false;
-    std::vector<std::thread> workers;
-};
+    class NeighborRange {
+    public:
+        NeighborRange(const Tree* tree, size_t vertex, size_t count) : tree_(tree), vertex_(vertex), count_(count) {}
+        NeighborIterator begin() const { return NeighborIterator(tree_, vertex_, 0); }
+        NeighborIterator end() const { return NeighborIterator(tree_, vertex_, count_); }
+        size_t size() const { return count_; }
+
+    private:
+        const Tree* tree_;
+        size_t vertex_;
+        size_t count_;
+    };
 
-// Tree class definition
-class Tree {
-public:
     Tree(int myVertices);
     // Constructor to initialize the Tree with n vertices
-    Tree(size_t n) : treeAdjList(n) {}
+    Tree(size_t n);
     Tree();
 
     void addEdge(size_t u, size_t v, double weight);
     void addEdge(size_t u, size_t v);
+    void finalize();  // Packs the collected edges into the CSR arrays
     bool isValid() const;
     void printTree() const;
     void printTree(std::ostream& os) const;
+    void printTree(std::string& out) const;  // Appends the same text, formatted without a stream
 
     // Metric functions
+    TreeMetrics calculateMetrics() const;  // All four metrics in one sweep
     double calculateTotalWeight() const;
     double calculateLongestDistance() const;
     double calculateAverageDistance() const;
@@ -55,8 +88,37 @@ public:
 
     double getEdgeWeight(size_t u, size_t v) const;
     int getEdgesCount() const;
-    std::vector<std::vector<std::pair<size_t, double>>> treeAdjList;
-    int vertices;  
+    size_t getVertices() const { return vertices; }
+
+    // Read access to the packed representation
+    NeighborRange neighbors(size_t u) const;
+    size_t parent(size_t v) const;         // NO_PARENT for the root of each component
+    double parentWeight(size_t v) const;   // Weight of the edge to parent(v)
+    const std::vector<double>& edgeWeights() const;  // One entry per edge, contiguous
+
+    // Calls f(TreeEdge) once per edge, parent before child
+    template <typename F>
+    void forEachEdge(F f) const {
+        ensureFinalized();
+        for (size_t p = 0; p < vertices; ++p) {
+            for (uint32_t slot = childOffset_[p]; slot < childOffset_[p + 1]; ++slot) {
+                f(TreeEdge{static_cast<uint32_t>(p), children_[slot], weights_[slot]});
+            }
+        }
+    }
+
+private:
+    void ensureFinalized() const;
+    void build() const;
+
+    size_t vertices = 0;
+    mutable std::vector<TreeEdge> pending_;      // Edges added since the last finalize()
+    mutable std::vector<uint32_t> parent_;       // parent_[v], or NO_PARENT for roots
+    mutable std::vector<uint32_t> parentEdge_;   // Slot of v in children_/weights_
+    mutable std::vector<uint32_t> childOffset_;  // Children of v are children_[childOffset_[v] .. childOffset_[v+1])
+    mutable std::vector<uint32_t> children_;
+    mutable std::vector<double> weights_;        // weights_[slot] is the weight of edge (parent, children_[slot])
+    mutable std::vector<uint32_t> rank_;         // rank_[slot] is the position of that edge in addEdge() order
 };
 
 #endif // TREE_HPP
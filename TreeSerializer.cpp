@@ -0,0 +1,203 @@
+#include "TreeSerializer.hpp"
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+void putU32(std::string& out, uint32_t value) {
+    char bytes[4];
+    for (size_t i = 0; i < 4; ++i) {
+        bytes[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+    out.append(bytes, 4);
+}
+
+void putF64(std::string& out, double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    char bytes[8];
+    for (size_t i = 0; i < 8; ++i) {
+        bytes[i] = static_cast<char>((bits >> (8 * i)) & 0xFF);
+    }
+    out.append(bytes, 8);
+}
+
+void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// Bounds-checked little-endian reader over the input buffer
+class Reader {
+public:
+    Reader(const char* data, size_t size) : data_(reinterpret_cast<const unsigned char*>(data)), size_(size) {}
+
+    uint8_t u8() {
+        need(1);
+        return data_[pos_++];
+    }
+
+    uint32_t u32() {
+        need(4);
+        uint32_t value = 0;
+        for (size_t i = 0; i < 4; ++i) {
+            value |= static_cast<uint32_t>(data_[pos_++]) << (8 * i);
+        }
+        return value;
+    }
+
+    double f64() {
+        need(8);
+        uint64_t bits = 0;
+        for (size_t i = 0; i < 8; ++i) {
+            bits |= static_cast<uint64_t>(data_[pos_++]) << (8 * i);
+        }
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            uint8_t byte = u8();
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        throw std::runtime_error("TreeSerializer: varint too long");
+    }
+
+private:
+    void need(size_t bytes) const {
+        if (size_ - pos_ < bytes) {
+            throw std::runtime_error("TreeSerializer: truncated input");
+        }
+    }
+
+    const unsigned char* data_;
+    size_t size_;
+    size_t pos_ = 0;
+};
+
+} // namespace
+
+void TreeSerializer::write(const Tree& tree, std::string& out, Encoding encoding) {
+    const size_t edges = static_cast<size_t>(tree.getEdgesCount());
+    out.reserve(out.size() + HEADER_SIZE + edges * (encoding == Encoding::PLAIN ? 16 : 12));
+
+    out.append("MSTB", 4);
+    out.push_back(static_cast<char>(VERSION));
+    out.push_back(static_cast<char>(encoding));
+    out.append(2, '\0');
+    putU32(out, static_cast<uint32_t>(tree.getVertices()));
+    putU32(out, static_cast<uint32_t>(edges));
+
+    if (encoding == Encoding::PLAIN) {
+        tree.forEachEdge([&out](const TreeEdge& edge) {
+            putU32(out, edge.u);
+            putU32(out, edge.v);
+            putF64(out, edge.weight);
+        });
+        return;
+    }
+
+    int64_t prevParent = 0;
+    int64_t prevChild = 0;
+    bool first = true;
+    tree.forEachEdge([&](const TreeEdge& edge) {
+        int64_t parent = edge.u;
+        int64_t child = edge.v;
+        if (first || parent != prevParent) {
+            prevChild = parent;  // First child of this parent is coded against the parent
+        }
+        first = false;
+        putVarint(out, static_cast<uint64_t>(parent - prevParent));
+        putVarint(out, zigzag(child - prevChild));
+        putF64(out, edge.weight);
+        prevParent = parent;
+        prevChild = child;
+    });
+}
+
+Tree TreeSerializer::read(const char* data, size_t size) {
+    Reader in(data, size);
+    if (size < HEADER_SIZE || std::memcmp(data, "MSTB", 4) != 0) {
+        throw std::runtime_error("TreeSerializer: bad magic");
+    }
+    for (size_t i = 0; i < 4; ++i) {
+        in.u8();
+    }
+    if (in.u8() != VERSION) {
+        throw std::runtime_error("TreeSerializer: unsupported version");
+    }
+    uint8_t encoding = in.u8();
+    in.u8();
+    in.u8();
+    size_t vertices = in.u32();
+    size_t edges = in.u32();
+
+    // The header is untrusted: check it against the buffer before allocating anything
+    if (encoding != static_cast<uint8_t>(Encoding::PLAIN) && encoding != static_cast<uint8_t>(Encoding::VARINT)) {
+        throw std::runtime_error("TreeSerializer: unknown encoding");
+    }
+    if (vertices >= Tree::NO_PARENT) {
+        throw std::runtime_error("TreeSerializer: too many vertices");
+    }
+    if (edges > 0 && edges > vertices - 1) {
+        throw std::runtime_error("TreeSerializer: more edges than a forest can have");
+    }
+    const size_t minRecord = encoding == static_cast<uint8_t>(Encoding::PLAIN) ? 16 : 10;
+    if (edges > (size - HEADER_SIZE) / minRecord) {
+        throw std::runtime_error("TreeSerializer: truncated input");
+    }
+
+    Tree tree(vertices);
+    int64_t prevParent = 0;
+    int64_t prevChild = 0;
+    for (size_t i = 0; i < edges; ++i) {
+        int64_t parent, child;
+        if (encoding == static_cast<uint8_t>(Encoding::PLAIN)) {
+            parent = in.u32();
+            child = in.u32();
+        } else {
+            // Both previous vertices are in range, so a valid delta is smaller than the vertex
+            // count; a larger one is corrupt and adding it could overflow
+            uint64_t parentDelta = in.varint();
+            int64_t childDelta = unzigzag(in.varint());
+            const int64_t limit = static_cast<int64_t>(vertices);
+            if (parentDelta >= vertices || childDelta <= -limit || childDelta >= limit) {
+                throw std::runtime_error("TreeSerializer: vertex out of range");
+            }
+            parent = prevParent + static_cast<int64_t>(parentDelta);
+            if (i == 0 || parent != prevParent) {
+                prevChild = parent;
+            }
+            child = prevChild + childDelta;
+            prevParent = parent;
+            prevChild = child;
+        }
+        if (parent < 0 || child < 0 || static_cast<size_t>(parent) >= vertices || static_cast<size_t>(child) >= vertices) {
+            throw std::runtime_error("TreeSerializer: vertex out of range");
+        }
+        tree.addEdge(static_cast<size_t>(parent), static_cast<size_t>(child), in.f64());
+    }
+    try {
+        tree.finalize();
+    } catch (const std::logic_error& e) {
+        throw std::runtime_error(std::string("TreeSerializer: ") + e.what());  // A cycle or repeated edge
+    }
+    return tree;
+}
@@ -0,0 +1,33 @@
+#ifndef TREESERIALIZER_HPP
+#define TREESERIALIZER_HPP
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include "Tree.hpp"
+
+/* Compact binary MST format, all integers little endian:
+    "MSTB"  u8 version  u8 encoding  u16 reserved  u32 vertices  u32 edges
+followed by one record per edge, parents in increasing order.
+    PLAIN:  u32 parent, u32 child, f64 weight                           (16 bytes)
+    VARINT: varint(parent delta), varint(zigzag child delta), f64 weight (~10 bytes)
+In VARINT, the parent delta is taken from the previous edge's parent, and the child
+delta from the previous sibling (or from the parent for a first child).
+*/
+class TreeSerializer {
+public:
+    enum class Encoding : uint8_t {
+        PLAIN = 0,
+        VARINT = 1
+    };
+
+    static constexpr uint8_t VERSION = 1;
+    static constexpr size_t HEADER_SIZE = 16;
+
+    // Appends the encoded tree to out
+    static void write(const Tree& tree, std::string& out, Encoding encoding);
+    // Decodes a buffer produced by write(); throws std::runtime_error if it is malformed
+    static Tree read(const char* data, size_t size);
+};
+
+#endif // TREESERIALIZER_HPP
@@ -0,0 +1,534 @@
+#include "UringServer.hpp"
+#include "WireProtocol.hpp"
+#include "Logger.hpp"
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <system_error>
+#include <utility>
+
+namespace {
+
+const uint16_t RECV_GROUP = 1;       // Buffer group id of the receive arena
+const size_t MAX_SEND = 1u << 30;    // Largest length of a single send SQE
+const size_t SPARE_LIMIT = 64 << 10; // Larger reply buffers are freed rather than kept for reuse
+
+} // namespace
+
+UringServer::UringServer(int listenFd, WorkStealingPool& workers, Reactor::OpenHandler onOpen,
+                         Reactor::CommandHandler onCommand, Reactor::CloseHandler onClose,
+                         const AdmissionLimits& limits)
+    : listenFd(listenFd), workers(workers), onOpenHandler(std::move(onOpen)),
+      onCommand(std::move(onCommand)), onCloseHandler(std::move(onClose)), limits(limits) {
+    if (this->limits.maxInFlight == 0) {
+        this->limits.maxInFlight = 4 * workers.size();
+    }
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ringFd = static_cast<int>(syscall(__NR_io_uring_setup, RING_ENTRIES, &params));
+    if (ringFd < 0) {
+        throw std::system_error(errno, std::generic_category(), "io_uring_setup");
+    }
+
+    try {
+        setUpRing(params);
+    } catch (...) {
+        releaseRing();
+        throw;
+    }
+}
+
+// Maps the rings, makes the wake eventfd and provides the receive buffers; a failed mapping
+// is left null so that releaseRing() frees exactly what was obtained
+void UringServer::setUpRing(const io_uring_params& params) {
+    // Map the submission ring, completion ring and SQE array
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap) {
+        sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+    }
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) {
+        sqRing = nullptr;
+        throw std::system_error(errno, std::generic_category(), "mmap sq ring");
+    }
+    cqRing = singleMmap ? sqRing
+                        : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+    if (cqRing == MAP_FAILED) {
+        cqRing = nullptr;
+        throw std::system_error(errno, std::generic_category(), "mmap cq ring");
+    }
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* mappedSqes = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (mappedSqes == MAP_FAILED) {
+        throw std::system_error(errno, std::generic_category(), "mmap sqes");
+    }
+    sqes = static_cast<io_uring_sqe*>(mappedSqes);
+
+    char* sq = static_cast<char*>(sqRing);
+    char* cq = static_cast<char*>(cqRing);
+    sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sqEntries = params.sq_entries;
+    cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    localTail = *sqTail;
+
+    wakeFd = eventfd(0, EFD_CLOEXEC);
+    if (wakeFd == -1) {
+        throw std::system_error(errno, std::generic_category(), "eventfd");
+    }
+    zeroCopy = probeZeroCopy();
+
+    // Hand the whole receive arena to the kernel as one buffer group
+    recvArena.resize(static_cast<size_t>(RECV_BUFFERS) * RECV_BUFFER_SIZE);
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = static_cast<int>(RECV_BUFFERS);
+    sqe->addr = reinterpret_cast<uint64_t>(recvArena.data());
+    sqe->len = RECV_BUFFER_SIZE;
+    sqe->off = 0;
+    sqe->buf_group = RECV_GROUP;
+    sqe->user_data = track(Op::PROVIDE, 0);
+}
+
+UringServer::~UringServer() {
+    for (auto& entry : connections) {
+        onCloseHandler(entry.second->fd);
+        close(entry.second->fd);
+        Stats::add(FrontEndStats::shared().connectionsActive, -1);
+    }
+    releaseRing();
+}
+
+void UringServer::releaseRing() {
+    if (sqes != nullptr) {
+        munmap(sqes, sqesSize);
+    }
+    if (cqRing != nullptr && cqRing != sqRing) {
+        munmap(cqRing, cqRingSize);
+    }
+    if (sqRing != nullptr) {
+        munmap(sqRing, sqRingSize);
+    }
+    close(ringFd);
+    if (wakeFd != -1) {
+        close(wakeFd);
+    }
+}
+
+bool UringServer::probeZeroCopy() {
+    const size_t ops = 256;
+    std::vector<char> buffer(sizeof(io_uring_probe) + ops * sizeof(io_uring_probe_op), 0);
+    io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+    if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PROBE, probe, ops) < 0) {
+        return false;
+    }
+    return probe->last_op >= IORING_OP_SEND_ZC && (probe->ops[IORING_OP_SEND_ZC].flags & IO_URING_OP_SUPPORTED);
+}
+
+int UringServer::enter(unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+// Returns a zeroed SQE; if the ring is full, what is queued so far is submitted first
+io_uring_sqe* UringServer::nextSqe() {
+    if (localTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+        __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+        int submitted = enter(unsubmitted, 0, 0);
+        if (submitted > 0) {
+            unsubmitted -= std::min(unsubmitted, static_cast<unsigned>(submitted));
+        }
+    }
+    unsigned index = localTail & *sqMask;
+    io_uring_sqe* sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqArray[index] = index;
+    ++localTail;
+    ++unsubmitted;
+    return sqe;
+}
+
+uint64_t UringServer::track(Op op, uint32_t connection, std::shared_ptr<std::string> buffer, bool zeroCopySend) {
+    uint64_t userData = nextUserData++;
+    pending[userData] = Pending{op, connection, std::move(buffer), zeroCopySend, op == Op::SEND ? Stats::now() : 0};
+    return userData;
+}
+
+void UringServer::queueAccept() {
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listenFd;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = track(Op::ACCEPT, 0);
+}
+
+void UringServer::queueWakeRead() {
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = wakeFd;
+    sqe->addr = reinterpret_cast<uint64_t>(&wakeValue);
+    sqe->len = sizeof(wakeValue);
+    sqe->user_data = track(Op::WAKE, 0);
+}
+
+// The kernel picks a buffer from the group only once data is there
+void UringServer::queueRecv(Connection& conn) {
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conn.fd;
+    sqe->len = RECV_BUFFER_SIZE;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RECV_GROUP;
+    sqe->user_data = track(Op::RECV, conn.id);
+    conn.recvInFlight = true;
+}
+
+void UringServer::provideBuffer(uint16_t bid) {
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = 1;
+    sqe->addr = reinterpret_cast<uint64_t>(recvArena.data() + static_cast<size_t>(bid) * RECV_BUFFER_SIZE);
+    sqe->len = RECV_BUFFER_SIZE;
+    sqe->off = bid;
+    sqe->buf_group = RECV_GROUP;
+    sqe->user_data = track(Op::PROVIDE, 0);
+}
+
+// A buffer is back in the group: the receives that found none get another try
+void UringServer::rearmStarved() {
+    std::vector<uint32_t> ids;
+    ids.swap(starved);
+    for (uint32_t id : ids) {
+        auto it = connections.find(id);
+        if (it != connections.end() && !it->second->closing && !it->second->recvInFlight) {
+            queueRecv(*it->second);
+        }
+    }
+}
+
+// Sends the rest of conn.sending, or starts on the queued output if nothing is in flight
+void UringServer::queueSend(Connection& conn) {
+    if (conn.sendInFlight) {
+        return;  // onSend() continues once the kernel reports this one
+    }
+    if (!conn.sending) {
+        if (conn.output.empty()) {
+            return;
+        }
+        conn.sending = std::make_shared<std::string>(std::move(conn.output));
+        conn.output.clear();
+        conn.sendOffset = 0;
+    }
+    size_t remaining = conn.sending->size() - conn.sendOffset;
+    bool useZeroCopy = zeroCopy && remaining >= ZEROCOPY_THRESHOLD;
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = useZeroCopy ? IORING_OP_SEND_ZC : IORING_OP_SEND;
+    sqe->fd = conn.fd;
+    sqe->addr = reinterpret_cast<uint64_t>(conn.sending->data() + conn.sendOffset);
+    sqe->len = static_cast<uint32_t>(std::min(remaining, MAX_SEND));
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = track(Op::SEND, conn.id, useZeroCopy ? conn.sending : nullptr, useZeroCopy);
+    conn.sendInFlight = true;
+}
+
+void UringServer::run() {
+    queueAccept();
+    queueWakeRead();
+    while (true) {
+        // One syscall submits everything queued since the last one and waits for completions
+        __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+        int submitted = enter(unsubmitted, 1, IORING_ENTER_GETEVENTS);
+        if (submitted < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "io_uring_enter");
+        }
+        unsubmitted -= std::min(unsubmitted, static_cast<unsigned>(submitted));
+
+        unsigned head = *cqHead;
+        unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            io_uring_cqe cqe = cqes[head & *cqMask];
+            ++head;
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+            handleCompletion(cqe);
+            tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        }
+    }
+}
+
+void UringServer::handleCompletion(const io_uring_cqe& cqe) {
+    auto it = pending.find(cqe.user_data);
+    if (it == pending.end()) {
+        return;
+    }
+    // The second CQE of a zero-copy send: the kernel no longer needs the buffer
+    if (cqe.flags & IORING_CQE_F_NOTIF) {
+        pending.erase(it);
+        return;
+    }
+    Pending op = it->second;
+    if (!(op.zeroCopy && (cqe.flags & IORING_CQE_F_MORE))) {
+        pending.erase(it);
+    }
+
+    switch (op.op) {
+        case Op::ACCEPT:
+            onAccept(cqe.res);
+            return;
+        case Op::WAKE:
+            drainCompletions();
+            queueWakeRead();
+            return;
+        case Op::PROVIDE:
+            if (cqe.res < 0) {
+                LOG(WARN) << "io_uring: provide buffers failed: " << strerror(-cqe.res);
+            }
+            rearmStarved();
+            return;
+        default:
+            break;
+    }
+
+    auto conn = connections.find(op.connection);
+    if (conn == connections.end()) {
+        return;
+    }
+    if (op.op == Op::RECV) {
+        onRecv(*conn->second, cqe.res, cqe.flags);
+    } else {
+        onSend(*conn->second, op, cqe.res);
+    }
+    closeIfDone(*conn->second);
+}
+
+void UringServer::onAccept(int res) {
+    queueAccept();
+    if (res < 0) {
+        if (res != -EINTR && res != -EAGAIN && res != -ECONNABORTED) {
+            LOG(WARN) << "accept: " << strerror(-res);
+        }
+        return;
+    }
+    if (connections.size() >= limits.maxConnections) {
+        std::string reply = limits.busyReply();
+        ssize_t sent = send(res, reply.data(), reply.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        (void)sent;
+        close(res);
+        Stats::add(FrontEndStats::shared().connectionsRejected);
+        return;
+    }
+    Stats::add(FrontEndStats::shared().connectionsAccepted);
+    Stats::add(FrontEndStats::shared().connectionsActive);
+    auto conn = std::make_unique<Connection>();
+    conn->id = nextConnection++;
+    conn->fd = res;
+    conn->negotiated = !onFrame;
+    Connection& ref = *conn;
+    connections[conn->id] = std::move(conn);
+    onOpenHandler(res);
+    queueRecv(ref);
+}
+
+void UringServer::onRecv(Connection& conn, int res, uint32_t flags) {
+    conn.recvInFlight = false;
+    if (flags & IORING_CQE_F_BUFFER) {
+        uint16_t bid = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+        if (res > 0) {
+            size_t size = static_cast<size_t>(res);
+            Stats::add(FrontEndStats::shared().bytesReceived, res);
+            std::memcpy(conn.input.prepare(size), recvArena.data() + static_cast<size_t>(bid) * RECV_BUFFER_SIZE, size);
+            conn.input.commit(size);
+        }
+        provideBuffer(bid);  // Copied out, so the buffer goes straight back to the group
+    }
+
+    if (res == -ENOBUFS) {
+        // Every buffer is on its way back: re-armed by the next provide completion rather than
+        // straight away, which would spin on ENOBUFS until the provide SQEs have run
+        starved.push_back(conn.id);
+        return;
+    }
+    if (res == -EINTR || res == -EAGAIN) {
+        queueRecv(conn);
+        return;
+    }
+    if (res <= 0) {
+        if (res < 0) {
+            conn.input.clear();
+        }
+        conn.closing = true;
+        return;
+    }
+
+    if (!conn.negotiated) {
+        conn.negotiated = WireProtocol::negotiate(conn.input, conn.binary, conn.output);
+        queueSend(conn);
+    }
+    if (conn.input.partialSize() > (conn.binary ? WireProtocol::MAX_FRAME : Reactor::MAX_LINE)) {
+        conn.output += conn.binary ? WireProtocol::frameTooLarge() : std::string("Command too long\n");
+        conn.closing = true;
+        queueSend(conn);
+        return;
+    }
+    if (!conn.closing) {
+        if (canRead(conn)) {
+            queueRecv(conn);
+        } else {
+            conn.recvPaused = true;  // Data stays in the socket until the queues drain
+        }
+    }
+    dispatch(conn);
+}
+
+void UringServer::onSend(Connection& conn, Pending& op, int res) {
+    conn.sendInFlight = false;
+    Stats::record(FrontEndStats::shared().sendTime, Stats::now() - op.queued);
+    if (res == -EOPNOTSUPP && op.zeroCopy) {
+        zeroCopy = false;  // This socket/kernel cannot do it; retry the same bytes normally
+        queueSend(conn);
+        return;
+    }
+    if (res < 0) {
+        conn.sending.reset();
+        conn.output.clear();
+        conn.input.clear();
+        conn.closing = true;
+        return;
+    }
+    Stats::add(FrontEndStats::shared().bytesSent, res);
+    conn.sendOffset += static_cast<size_t>(res);
+    if (conn.sendOffset < conn.sending->size()) {
+        queueSend(conn);  // Partial write: continue from where it stopped
+        return;
+    }
+    if (conn.sending.use_count() == 1) {
+        recycle(conn, std::move(*conn.sending));  // Not pinned by a zero-copy notification
+    }
+    conn.sending.reset();
+    queueSend(conn);
+    resumeRecv(conn);
+}
+
+bool UringServer::canRead(const Connection& conn) const {
+    return conn.input.lineCount() < limits.maxQueuedCommands && conn.output.size() < limits.maxOutput;
+}
+
+void UringServer::recycle(Connection& conn, std::string&& buffer) {
+    if (buffer.capacity() > conn.spare.capacity() && buffer.capacity() <= SPARE_LIMIT) {
+        buffer.clear();
+        conn.spare = std::move(buffer);
+    }
+}
+
+void UringServer::resumeRecv(Connection& conn) {
+    if (conn.recvPaused && !conn.closing && canRead(conn)) {
+        conn.recvPaused = false;
+        queueRecv(conn);
+    }
+}
+
+void UringServer::dispatch(Connection& conn) {
+    if (conn.busy || conn.waiting || conn.input.lineCount() == 0 || !conn.negotiated) {
+        return;
+    }
+    if (inFlight >= limits.maxInFlight) {
+        conn.waiting = true;
+        waitingForSlot.push_back(conn.id);
+        return;
+    }
+    conn.busy = true;
+    ++inFlight;
+    std::string batch(conn.input.completeLines());  // Every complete line goes in one task
+    conn.input.consumeLines();
+    uint32_t id = conn.id;
+    int fd = conn.fd;
+    bool binary = conn.binary;
+    std::string output = std::move(conn.spare);
+    conn.spare.clear();
+    uint64_t queued = Stats::now();
+    workers.submit([this, id, fd, binary, queued, batch = std::move(batch), output = std::move(output)]() mutable {
+        Stats::record(FrontEndStats::shared().computeQueueWait, Stats::now() - queued);
+        Completion done{id, std::move(output), true};
+        done.keep = Reactor::runBatch(fd, batch, binary, onCommand, onFrame, done.output);
+        {
+            std::lock_guard<std::mutex> lock(completionsMutex);
+            completions.push_back(std::move(done));
+        }
+        uint64_t one = 1;
+        ssize_t written = write(wakeFd, &one, sizeof(one));
+        (void)written;
+    });
+}
+
+void UringServer::drainCompletions() {
+    std::vector<Completion> done;
+    {
+        std::lock_guard<std::mutex> lock(completionsMutex);
+        done.swap(completions);
+    }
+    for (Completion& completion : done) {
+        auto it = connections.find(completion.connection);
+        if (it == connections.end()) {
+            continue;
+        }
+        Connection& conn = *it->second;
+        conn.busy = false;
+        --inFlight;
+        if (conn.output.empty()) {
+            conn.output.swap(completion.output);
+        } else {
+            conn.output += completion.output;
+        }
+        recycle(conn, std::move(completion.output));
+        if (!completion.keep) {
+            conn.closing = true;
+            conn.input.clear();
+        }
+        queueSend(conn);
+        dispatch(conn);
+        resumeRecv(conn);
+        closeIfDone(conn);
+    }
+
+    // Slots freed above go to the connections that have waited longest
+    while (inFlight < limits.maxInFlight && !waitingForSlot.empty()) {
+        auto it = connections.find(waitingForSlot.front());
+        waitingForSlot.pop_front();
+        if (it == connections.end() || !it->second->waiting) {
+            continue;
+        }
+        Connection& conn = *it->second;
+        conn.waiting = false;
+        dispatch(conn);
+        resumeRecv(conn);
+        closeIfDone(conn);
+    }
+}
+
+void UringServer::closeIfDone(Connection& conn) {
+    if (!conn.closing || conn.busy || conn.input.lineCount() > 0 || !conn.output.empty() || conn.sending || conn.sendInFlight) {
+        return;
+    }
+    if (conn.recvInFlight) {
+        shutdown(conn.fd, SHUT_RD);  // Completes the outstanding receive; we close after it
+        return;
+    }
+    int fd = conn.fd;
+    connections.erase(conn.id);  // conn is destroyed here
+    onCloseHandler(fd);
+    close(fd);
+    Stats::add(FrontEndStats::shared().connectionsActive, -1);
+}
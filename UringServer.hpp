@@ -0,0 +1,155 @@
+#ifndef URINGSERVER_HPP
+#define URINGSERVER_HPP
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include "Reactor.hpp"
+#include "ThreadPool.hpp"
+
+/* io_uring front end (Linux 5.19+, raw syscalls, no liburing).
+Same connection model as Reactor: one I/O thread, the complete lines of a connection
+handed to the worker pool as one batch at a time, replies written back in order. The difference is how
+I/O reaches the kernel:
+  - accepts, receives and sends from every connection are queued as SQEs and submitted
+    together with a single io_uring_enter per loop iteration, which also reaps completions;
+  - receives use a buffer group registered with the kernel (IOSQE_BUFFER_SELECT), so a
+    buffer is only taken when data actually arrives and idle connections pin none;
+  - replies of ZEROCOPY_THRESHOLD bytes or more go out with IORING_OP_SEND_ZC when the
+    kernel supports it; the reply buffer is kept alive until its notification arrives;
+  - partial sends are resubmitted from where they stopped.
+Workers post finished commands through an eventfd that is itself read through the ring.
+AdmissionLimits apply as in Reactor: a connection over its bounds gets no new receive
+until it drains, and commands beyond maxInFlight wait for a pool slot in FIFO order.
+*/
+class UringServer {
+public:
+    static const size_t ZEROCOPY_THRESHOLD = 1 << 20;
+    static const unsigned RING_ENTRIES = 4096;
+    static const unsigned RECV_BUFFERS = 1024;
+    static const unsigned RECV_BUFFER_SIZE = 16384;
+
+    // Throws std::system_error if io_uring is unavailable
+    UringServer(int listenFd, WorkStealingPool& workers, Reactor::OpenHandler onOpen,
+                Reactor::CommandHandler onCommand, Reactor::CloseHandler onClose,
+                const AdmissionLimits& limits = AdmissionLimits());
+    ~UringServer();
+
+    // Runs the event loop on the calling thread
+    void run();
+    bool zeroCopySupported() const { return zeroCopy; }
+    // Serves WireProtocol clients on the same port, as Reactor::setFrameHandler; call before run()
+    void setFrameHandler(Reactor::FrameHandler handler) { onFrame = std::move(handler); }
+
+private:
+    enum class Op : uint8_t { ACCEPT, RECV, SEND, WAKE, PROVIDE };
+
+    struct Connection {
+        uint32_t id;
+        int fd;
+        LineBuffer input;                      // Complete lines wait here for a worker
+        std::string output;                    // Replies not yet handed to a send
+        std::shared_ptr<std::string> sending;  // Buffer of the send in flight
+        size_t sendOffset = 0;
+        std::string spare;                     // A sent reply buffer, cleared; the next batch writes into it
+        bool sendInFlight = false;             // At most one send SQE per connection, so bytes stay in order
+        bool recvInFlight = false;
+        bool recvPaused = false;               // No receive queued because of backpressure
+        bool busy = false;
+        bool waiting = false;                  // In the queue for a pool slot
+        bool closing = false;
+        bool negotiated = false;               // The protocol is known (always, without onFrame)
+        bool binary = false;                   // WireProtocol frames rather than text lines
+    };
+
+    // Everything in flight in the ring, keyed by the SQE user_data
+    struct Pending {
+        Op op;
+        uint32_t connection;
+        std::shared_ptr<std::string> buffer;  // Zero-copy sends keep their buffer here
+        bool zeroCopy = false;
+        uint64_t queued = 0;                  // Sends: when the SQE was prepared
+    };
+
+    struct Completion {
+        uint32_t connection;
+        std::string output;
+        bool keep;
+    };
+
+    io_uring_sqe* nextSqe();
+    uint64_t track(Op op, uint32_t connection, std::shared_ptr<std::string> buffer = nullptr, bool zeroCopy = false);
+    int enter(unsigned toSubmit, unsigned minComplete, unsigned flags);
+
+    void queueAccept();
+    void queueRecv(Connection& conn);
+    void queueSend(Connection& conn);
+    void queueWakeRead();
+    void provideBuffer(uint16_t bid);
+    void rearmStarved();
+
+    void handleCompletion(const io_uring_cqe& cqe);
+    void onAccept(int res);
+    void onRecv(Connection& conn, int res, uint32_t flags);
+    void onSend(Connection& conn, Pending& pending, int res);
+    void drainCompletions();
+    void dispatch(Connection& conn);
+    void closeIfDone(Connection& conn);
+    bool canRead(const Connection& conn) const;
+    void resumeRecv(Connection& conn);
+    void recycle(Connection& conn, std::string&& buffer);
+    bool probeZeroCopy();
+    void setUpRing(const io_uring_params& params);
+    void releaseRing();  // Unmaps and closes whatever the constructor got so far
+
+    int listenFd;
+    int wakeFd = -1;
+    WorkStealingPool& workers;
+    Reactor::OpenHandler onOpenHandler;
+    Reactor::CommandHandler onCommand;
+    Reactor::CloseHandler onCloseHandler;
+    Reactor::FrameHandler onFrame;
+    bool zeroCopy = false;
+    AdmissionLimits limits;
+    size_t inFlight = 0;
+    std::deque<uint32_t> waitingForSlot;
+
+    // Ring state
+    int ringFd = -1;
+    void* sqRing = nullptr;
+    size_t sqRingSize = 0;
+    void* cqRing = nullptr;
+    size_t cqRingSize = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqesSize = 0;
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    unsigned sqEntries;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    io_uring_cqe* cqes;
+    unsigned localTail;   // SQEs prepared but not yet published
+    unsigned unsubmitted = 0;
+
+    std::vector<char> recvArena;  // RECV_BUFFERS * RECV_BUFFER_SIZE bytes, owned by the kernel while provided
+    std::vector<uint32_t> starved;  // Connections whose receive found no buffer, re-armed once one is back
+    uint64_t wakeValue = 0;
+
+    uint64_t nextUserData = 1;
+    std::unordered_map<uint64_t, Pending> pending;
+    uint32_t nextConnection = 1;
+    std::unordered_map<uint32_t, std::unique_ptr<Connection>> connections;
+
+    std::mutex completionsMutex;
+    std::vector<Completion> completions;
+};
+
+#endif // URINGSERVER_HPP
@@ -0,0 +1,120 @@
+#include "WireProtocol.hpp"
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+const char MAGIC[4] = {'\0', 'M', 'S', 'P'};
+
+} // namespace
+
+WireProtocol::Detection WireProtocol::detect(std::string_view head) {
+    size_t compared = std::min(head.size(), sizeof(MAGIC));
+    if (std::memcmp(head.data(), MAGIC, compared) != 0) {
+        return Detection::TEXT;
+    }
+    return head.size() < HELLO_SIZE ? Detection::UNDECIDED : Detection::BINARY;
+}
+
+bool WireProtocol::negotiate(LineBuffer& input, bool& binary, std::string& out) {
+    switch (detect(input.unconsumed())) {
+        case Detection::UNDECIDED:
+            return false;
+        case Detection::TEXT:
+            binary = false;
+            return true;
+        case Detection::BINARY:
+            break;
+    }
+    binary = true;
+    input.useFrames(HELLO_SIZE);
+    appendHello(out);
+    return true;
+}
+
+void WireProtocol::appendHello(std::string& out) {
+    out.append(MAGIC, sizeof(MAGIC));
+    out.push_back(static_cast<char>(VERSION));
+}
+
+size_t WireProtocol::beginReply(std::string& out, uint8_t type, Status status) {
+    size_t start = out.size();
+    putU32(out, 0);  // Length, filled in by endReply()
+    out.push_back(static_cast<char>(type));
+    out.push_back(static_cast<char>(status));
+    return start;
+}
+
+void WireProtocol::endReply(std::string& out, size_t start) {
+    uint32_t length = static_cast<uint32_t>(out.size() - start - LineBuffer::FRAME_HEADER);
+    for (size_t i = 0; i < 4; ++i) {
+        out[start + i] = static_cast<char>((length >> (8 * i)) & 0xFF);
+    }
+}
+
+void WireProtocol::appendError(std::string& out, uint8_t type, std::string_view message) {
+    size_t start = beginReply(out, type, Status::ERROR);
+    out.append(message.data(), message.size());
+    endReply(out, start);
+}
+
+std::string WireProtocol::frameTooLarge() {
+    std::string out;
+    appendError(out, 0, "Frame too large");
+    return out;
+}
+
+void WireProtocol::putU32(std::string& out, uint32_t value) {
+    char bytes[4];
+    for (size_t i = 0; i < 4; ++i) {
+        bytes[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+    out.append(bytes, 4);
+}
+
+void WireProtocol::putF64(std::string& out, double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    char bytes[8];
+    for (size_t i = 0; i < 8; ++i) {
+        bytes[i] = static_cast<char>((bits >> (8 * i)) & 0xFF);
+    }
+    out.append(bytes, 8);
+}
+
+uint8_t WireProtocol::Reader::u8() {
+    need(1);
+    return static_cast<uint8_t>(data_[pos_++]);
+}
+
+uint32_t WireProtocol::Reader::u32() {
+    need(4);
+    uint32_t value = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        value |= static_cast<uint32_t>(static_cast<uint8_t>(data_[pos_++])) << (8 * i);
+    }
+    return value;
+}
+
+double WireProtocol::Reader::f64() {
+    need(8);
+    uint64_t bits = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        bits |= static_cast<uint64_t>(static_cast<uint8_t>(data_[pos_++])) << (8 * i);
+    }
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+std::string_view WireProtocol::Reader::rest() {
+    std::string_view tail = data_.substr(pos_);
+    pos_ = data_.size();
+    return tail;
+}
+
+void WireProtocol::Reader::need(size_t bytes) const {
+    if (data_.size() - pos_ < bytes) {
+        throw std::runtime_error("truncated frame");
+    }
+}
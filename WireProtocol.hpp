@@ -0,0 +1,90 @@
+#ifndef WIREPROTOCOL_HPP
+#define WIREPROTOCOL_HPP
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include "LineBuffer.hpp"
+
+/* Binary protocol, served on the same port as the text one.
+A client selects it by starting the connection with the 5-byte hello
+    "\0MSP"  u8 version
+(a NUL can never start a text command); the server answers with its own hello. From then
+on both directions are frames, all integers little endian:
+    u32 payload length  u8 type  payload
+Requests and their payloads:
+    NEW_GRAPH     u32 vertices [, name]  with a name (up to GraphRegistry::MAX_NAME bytes),
+                  creates or resets that shared graph
+    ADD_EDGES     u32 count, count x (u32 u, u32 v, f64 weight)
+    REMOVE_EDGES  u32 count, count x (u32 u, u32 v)
+    MST           u8 algorithm (MSTFactory::Algorithm order), u8 TreeSerializer::Encoding
+    METRICS       (empty) metrics of the last MST
+    END           (empty) the server closes after replying
+    OPEN_GRAPH    name  later frames work on that shared graph
+Every request gets exactly one reply frame of the same type whose payload starts with a
+status byte. OK is followed by: ADD_EDGES / REMOVE_EDGES u32 count applied; MST the
+TreeSerializer image; METRICS f64 total, f64 longest, f64 average, f64 shortest, u32 edges;
+OPEN_GRAPH u32 vertices. ERROR is followed by a UTF-8 message. Names are UTF-8, up to the end
+of the payload.
+*/
+class WireProtocol {
+public:
+    enum class Frame : uint8_t {
+        NEW_GRAPH = 1,
+        ADD_EDGES = 2,
+        REMOVE_EDGES = 3,
+        MST = 4,
+        METRICS = 5,
+        END = 6,
+        OPEN_GRAPH = 7
+    };
+
+    enum class Status : uint8_t {
+        OK = 0,
+        ERROR = 1
+    };
+
+    enum class Detection { TEXT, BINARY, UNDECIDED };
+
+    static constexpr uint8_t VERSION = 1;
+    static constexpr size_t HELLO_SIZE = 5;
+    static constexpr size_t MAX_FRAME = 64 << 20;  // Largest frame accepted, header included
+
+    // Looks at the first bytes of a connection; UNDECIDED until there are enough of them
+    static Detection detect(std::string_view head);
+    // Decides the protocol once enough input arrived: switches input to frames and appends
+    // the server hello to out for binary clients. Returns false while still undecided.
+    static bool negotiate(LineBuffer& input, bool& binary, std::string& out);
+    static void appendHello(std::string& out);
+
+    // Reply frames: open, append the payload, close (which fills in the length)
+    static size_t beginReply(std::string& out, uint8_t type, Status status);
+    static void endReply(std::string& out, size_t start);
+    static void appendError(std::string& out, uint8_t type, std::string_view message);
+    // Sent (with type 0) before closing a connection that announced a frame over MAX_FRAME
+    static std::string frameTooLarge();
+
+    static void putU32(std::string& out, uint32_t value);
+    static void putF64(std::string& out, double value);
+
+    // Bounds-checked little-endian reader over a request payload; throws std::runtime_error
+    class Reader {
+    public:
+        explicit Reader(std::string_view data) : data_(data) {}
+
+        uint8_t u8();
+        uint32_t u32();
+        double f64();
+        size_t remaining() const { return data_.size() - pos_; }
+        std::string_view rest();  // Everything not read yet
+
+    private:
+        void need(size_t bytes) const;
+
+        std::string_view data_;
+        size_t pos_ = 0;
+    };
+};
+
+#endif // WIREPROTOCOL_HPP
@@ -0,0 +1,472 @@
+/* Benchmark harness for the MST algorithms and the tree metrics (make bench).
+Every MSTFactory algorithm and every metric runs over a matrix of generated graphs:
+  sparse  connected random graph with 2 edges per vertex
+  grid    square lattice (road-network like), about 2 edges per vertex
+  medium  connected random graph with 16 edges per vertex
+  dense   connected random graph with V * sqrt(V) / 2 edges
+at 10^3 .. 10^7 vertices, skipping graphs above the edge limit (-e). Graphs are seeded,
+so every run measures the same inputs, and weights are integers so IntegerMST sees the
+same graph as the others.
+The binary MST format (TreeSerializer) is timed both ways on the same tree, after
+checking that it reads back what was written.
+Each (family, size) runs in a child process of its own: a crash cannot take the whole
+run down and the heap starts empty. Inside it every case is timed over several runs and
+reports the median and p99 (nearest rank, so the maximum with fewer than 100 runs),
+edges per second at the median, the peak resident set while it ran (VmHWM, reset between
+cases) and the allocations per run (operator new is counted below).
+Output is one tab-separated row per case on stdout. With -b, rows are compared with a
+baseline file in the same format; cases slower than the threshold are reported on stderr
+and make the exit status 2.
+The recursive algorithms (TarjanMST's DFS, BoruvkaMST's find) run on a thread with a large
+stack and are limited to MAX_RECURSIVE_VERTICES.
+*/
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <random>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <unistd.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include "Graph.hpp"
+#include "Tree.hpp"
+#include "MSTFactory.hpp"
+#include "calculate.hpp"
+#include "TreeSerializer.hpp"
+
+namespace {
+
+std::atomic<uint64_t> allocations{0};
+std::atomic<uint64_t> allocatedBytes{0};
+
+} // namespace
+
+// Every allocation of the process goes through here, so each case can report its own.
+// Not inlined: GCC would then see free() on a pointer from operator new and refuse it
+__attribute__((noinline)) void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    void* block = std::malloc(size == 0 ? 1 : size);
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+__attribute__((noinline)) void operator delete(void* block) noexcept {
+    std::free(block);
+}
+
+__attribute__((noinline)) void operator delete(void* block, size_t) noexcept {
+    std::free(block);
+}
+
+namespace {
+
+const size_t MAX_RECURSIVE_VERTICES = 1000000;
+const size_t CASE_STACK = 1ul << 30;  // Reserved for the recursive algorithms, touched only as deep as they go
+const uint64_t SEED = 42;
+
+struct Options {
+    size_t runs = 11;
+    double budgetSeconds = 5.0;       // A case stops after this much time once it has MIN_RUNS
+    size_t maxVertices = 10000000;
+    size_t maxEdges = 20000000;
+    std::vector<std::string> families = {"sparse", "grid", "medium", "dense"};
+    std::string baseline;
+    double threshold = 10.0;          // Percent slower than the baseline that counts as a regression
+};
+
+// Cases faster than this vary by more than any threshold from scheduling alone; their change is shown, not reported
+const double NOISE_FLOOR_MS = 0.1;
+
+const size_t MIN_RUNS = 3;
+
+const char* const COLUMNS = "kind\tname\tfamily\tvertices\tedges\truns\tmedian_ms\tp99_ms\tedges_per_s\tpeak_rss_kb\tallocs_per_run\talloc_bytes_per_run";
+
+size_t edgeCount(const std::string& family, size_t vertices) {
+    if (family == "sparse") {
+        return 2 * vertices;
+    }
+    if (family == "medium") {
+        return 16 * vertices;
+    }
+    if (family == "dense") {
+        double complete = (double)vertices * (double)(vertices - 1) / 2;
+        return (size_t)std::min(complete, (double)vertices * std::sqrt((double)vertices) / 2);
+    }
+    size_t side = (size_t)std::sqrt((double)vertices);
+    return 2 * side * (side - 1);  // grid
+}
+
+// Connected: a random spanning tree first, then uniformly random extra edges
+std::vector<Graph::WeightedEdge> generate(const std::string& family, size_t vertices, size_t& usedVertices) {
+    std::mt19937_64 random(SEED + vertices);
+    std::uniform_int_distribution<int> weight(1, 1000);
+    std::vector<Graph::WeightedEdge> edges;
+    usedVertices = vertices;
+    if (family == "grid") {
+        size_t side = (size_t)std::sqrt((double)vertices);
+        usedVertices = side * side;
+        edges.reserve(edgeCount(family, vertices));
+        for (size_t row = 0; row < side; ++row) {
+            for (size_t col = 0; col < side; ++col) {
+                uint32_t v = (uint32_t)(row * side + col);
+                if (col + 1 < side) {
+                    edges.push_back({v, v + 1, (double)weight(random)});
+                }
+                if (row + 1 < side) {
+                    edges.push_back({v, (uint32_t)(v + side), (double)weight(random)});
+                }
+            }
+        }
+        return edges;
+    }
+    size_t total = std::max(edgeCount(family, vertices), vertices - 1);
+    edges.reserve(total);
+    for (size_t v = 1; v < vertices; ++v) {
+        std::uniform_int_distribution<size_t> earlier(0, v - 1);
+        edges.push_back({(uint32_t)earlier(random), (uint32_t)v, (double)weight(random)});
+    }
+    std::uniform_int_distribution<size_t> any(0, vertices - 1);
+    while (edges.size() < total) {
+        size_t u = any(random), v = any(random);
+        if (u != v) {
+            edges.push_back({(uint32_t)u, (uint32_t)v, (double)weight(random)});
+        }
+    }
+    return edges;
+}
+
+// Peak resident set since the last reset, in kB
+size_t peakRss() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return std::stoul(line.substr(6));
+        }
+    }
+    return 0;
+}
+
+// Returns freed memory to the system and restarts VmHWM from the current resident set
+void resetPeakRss() {
+    malloc_trim(0);
+    std::ofstream clear("/proc/self/clear_refs");
+    clear << "5";
+}
+
+struct Sample {
+    std::vector<double> seconds;
+    size_t peakKb = 0;
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+};
+
+Sample measure(const Options& options, const std::function<void()>& body) {
+    Sample sample;
+    resetPeakRss();
+    uint64_t allocationsBefore = allocations.load(), bytesBefore = allocatedBytes.load();
+    auto started = std::chrono::steady_clock::now();
+    while (sample.seconds.size() < options.runs) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        auto end = std::chrono::steady_clock::now();
+        sample.seconds.push_back(std::chrono::duration<double>(end - start).count());
+        if (sample.seconds.size() >= MIN_RUNS && std::chrono::duration<double>(end - started).count() > options.budgetSeconds) {
+            break;
+        }
+    }
+    sample.peakKb = peakRss();
+    sample.allocations = (allocations.load() - allocationsBefore) / sample.seconds.size();
+    sample.bytes = (allocatedBytes.load() - bytesBefore) / sample.seconds.size();
+    return sample;
+}
+
+double percentile(std::vector<double> values, double q) {
+    std::sort(values.begin(), values.end());
+    size_t rank = (size_t)std::ceil(q * (double)values.size());
+    return values[std::min(values.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+void printRow(const char* kind, const std::string& name, const std::string& family, size_t vertices, size_t edges,
+              const Sample& sample) {
+    double median = percentile(sample.seconds, 0.5);
+    std::printf("%s\t%s\t%s\t%zu\t%zu\t%zu\t%.6f\t%.6f\t%.0f\t%zu\t%llu\t%llu\n", kind, name.c_str(), family.c_str(), vertices,
+                edges, sample.seconds.size(), median * 1e3, percentile(sample.seconds, 0.99) * 1e3,
+                median > 0 ? (double)edges / median : 0.0, sample.peakKb, (unsigned long long)sample.allocations,
+                (unsigned long long)sample.bytes);
+    std::fflush(stdout);
+}
+
+struct Job {
+    const Options* options;
+    std::string family;
+    size_t vertices;
+};
+
+// Runs every case of one graph; the body of a child process
+void* runGraph(void* argument) {
+    const Job& job = *static_cast<const Job*>(argument);
+    const Options& options = *job.options;
+    size_t vertices;
+    std::vector<Graph::WeightedEdge> edges = generate(job.family, job.vertices, vertices);
+    size_t edgeTotal = edges.size();
+    Graph graph((int)vertices);
+    graph.addEdges(edges);
+    std::vector<Graph::WeightedEdge>().swap(edges);
+
+    const MSTFactory::Algorithm algorithms[] = {MSTFactory::Algorithm::KRUSKAL, MSTFactory::Algorithm::PRIM,
+                                                MSTFactory::Algorithm::Boruvka, MSTFactory::Algorithm::Tarjan,
+                                                MSTFactory::Algorithm::Integer};
+    for (MSTFactory::Algorithm algorithm : algorithms) {
+        bool recursive = algorithm == MSTFactory::Algorithm::Boruvka || algorithm == MSTFactory::Algorithm::Tarjan;
+        if (recursive && vertices > MAX_RECURSIVE_VERTICES) {
+            continue;
+        }
+        std::unique_ptr<MSTStrategy> strategy = MSTFactory::createMSTStrategy(algorithm);
+        Sample sample = measure(options, [&] {
+            Tree mst = strategy->computeMST(graph);
+            if (mst.getEdgesCount() < 0) {
+                std::abort();  // Keeps the result alive
+            }
+        });
+        printRow("mst", MSTFactory::name(algorithm), job.family, vertices, edgeTotal, sample);
+    }
+
+    // The metrics run on the tree every algorithm should agree on
+    Tree mst = MSTFactory::createMSTStrategy(MSTFactory::Algorithm::KRUSKAL)->computeMST(graph);
+    size_t treeEdges = (size_t)mst.getEdgesCount();
+    volatile double sink = 0;
+    const std::vector<std::pair<const char*, std::function<void()>>> metrics = {
+        {"calculateMetrics", [&] { sink = mst.calculateMetrics().totalWeight; }},
+        {"calculateTotalWeight", [&] { sink = mst.calculateTotalWeight(); }},
+        {"calculateLongestDistance", [&] { sink = mst.calculateLongestDistance(); }},
+        {"calculateAverageDistance", [&] { sink = mst.calculateAverageDistance(); }},
+        {"calculateShortestDistance", [&] { sink = mst.calculateShortestDistance(); }},
+        {"stage:total_weight", [&] { sink = (double)calculateTotalWeight(mst).size(); }},
+        {"stage:longest_distance", [&] { sink = (double)calculateLongestDistance(mst).size(); }},
+        {"stage:average_distance", [&] { sink = (double)calculateAverageDistance(mst).size(); }},
+        {"stage:shortest_distance", [&] { sink = (double)calculateShortestDistance(mst).size(); }},
+    };
+    for (const auto& metric : metrics) {
+        printRow("metric", metric.first, job.family, vertices, treeEdges, measure(options, metric.second));
+    }
+
+    // The binary MST reply in both encodings; decoding must give back the same tree
+    const std::pair<const char*, TreeSerializer::Encoding> encodings[] = {{"plain", TreeSerializer::Encoding::PLAIN},
+                                                                         {"varint", TreeSerializer::Encoding::VARINT}};
+    for (const auto& encoding : encodings) {
+        std::string blob;
+        TreeSerializer::write(mst, blob, encoding.second);
+        Tree decoded = TreeSerializer::read(blob.data(), blob.size());
+        if ((size_t)decoded.getEdgesCount() != treeEdges || decoded.calculateTotalWeight() != mst.calculateTotalWeight()) {
+            std::fprintf(stderr, "bench: %s round trip of the %s MST lost edges\n", encoding.first, job.family.c_str());
+            std::abort();
+        }
+        std::string scratch;
+        printRow("serializer", std::string("write:") + encoding.first, job.family, vertices, treeEdges, measure(options, [&] {
+            scratch.clear();
+            TreeSerializer::write(mst, scratch, encoding.second);
+            sink = (double)scratch.size();
+        }));
+        printRow("serializer", std::string("read:") + encoding.first, job.family, vertices, treeEdges, measure(options, [&] {
+            sink = (double)TreeSerializer::read(blob.data(), blob.size()).getEdgesCount();
+        }));
+    }
+    return nullptr;
+}
+
+// Forks a child for the graph and returns its rows; empty if it failed
+std::vector<std::string> runIsolated(const Job& job) {
+    int fds[2];
+    if (pipe(fds) == -1) {
+        std::perror("pipe");
+        return {};
+    }
+    std::fflush(stdout);
+    pid_t child = fork();
+    if (child == 0) {
+        close(fds[0]);
+        dup2(fds[1], STDOUT_FILENO);
+        pthread_attr_t attributes;
+        pthread_attr_init(&attributes);
+        pthread_attr_setstacksize(&attributes, CASE_STACK);
+        pthread_t thread;
+        if (pthread_create(&thread, &attributes, runGraph, const_cast<Job*>(&job)) != 0) {
+            _exit(1);
+        }
+        pthread_join(thread, nullptr);
+        std::fflush(stdout);
+        _exit(0);
+    }
+    close(fds[1]);
+    std::string output;
+    char buffer[4096];
+    ssize_t received;
+    while ((received = read(fds[0], buffer, sizeof buffer)) > 0) {
+        output.append(buffer, (size_t)received);
+    }
+    close(fds[0]);
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        std::cerr << "bench: " << job.family << " " << job.vertices << " failed (status " << status << ")\n";
+    }
+    std::vector<std::string> rows;
+    std::istringstream lines(output);
+    std::string line;
+    while (std::getline(lines, line)) {
+        rows.push_back(line);
+    }
+    return rows;
+}
+
+std::vector<std::string> split(const std::string& row) {
+    std::vector<std::string> fields;
+    std::istringstream in(row);
+    std::string field;
+    while (std::getline(in, field, '\t')) {
+        fields.push_back(field);
+    }
+    return fields;
+}
+
+// kind, name, family and vertices identify a case
+std::string caseKey(const std::vector<std::string>& fields) {
+    return fields[0] + "\t" + fields[1] + "\t" + fields[2] + "\t" + fields[3];
+}
+
+// Median milliseconds of every case in a previous run's output
+std::map<std::string, double> loadBaseline(const std::string& path) {
+    std::map<std::string, double> medians;
+    std::ifstream in(path);
+    std::string row;
+    while (std::getline(in, row)) {
+        std::vector<std::string> fields = split(row);
+        if (fields.size() >= 7 && fields[0] != "kind") {
+            medians[caseKey(fields)] = std::strtod(fields[6].c_str(), nullptr);
+        }
+    }
+    return medians;
+}
+
+std::vector<std::string> splitList(const std::string& list) {
+    std::vector<std::string> items;
+    std::istringstream in(list);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        items.push_back(item);
+    }
+    return items;
+}
+
+void usage(const char* program) {
+    std::cerr << "Usage: " << program << " [-r runs] [-t seconds] [-v max_vertices] [-e max_edges] [-f families] [-b baseline] [-x percent]\n"
+              << "  -r  runs per case (default: 11; at least 3, fewer if the time budget runs out)\n"
+              << "  -t  time budget per case in seconds (default: 5)\n"
+              << "  -v  largest graph, in vertices (default: 10000000)\n"
+              << "  -e  skip graphs with more edges than this (default: 20000000)\n"
+              << "  -f  comma-separated graph families out of sparse,grid,medium,dense (default: all)\n"
+              << "  -b  compare with an earlier output and report the cases that got slower\n"
+              << "  -x  percent slower than the baseline that is reported (default: 10)\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    int opt;
+    while ((opt = getopt(argc, argv, "r:t:v:e:f:b:x:")) != -1) {
+        switch (opt) {
+            case 'r':
+                options.runs = std::max(1ul, std::stoul(optarg));
+                break;
+            case 't':
+                options.budgetSeconds = std::stod(optarg);
+                break;
+            case 'v':
+                options.maxVertices = std::stoul(optarg);
+                break;
+            case 'e':
+                options.maxEdges = std::stoul(optarg);
+                break;
+            case 'f':
+                options.families = splitList(optarg);
+                break;
+            case 'b':
+                options.baseline = optarg;
+                break;
+            case 'x':
+                options.threshold = std::stod(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    for (const std::string& family : options.families) {
+        if (family != "sparse" && family != "grid" && family != "medium" && family != "dense") {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::map<std::string, double> baseline;
+    if (!options.baseline.empty()) {
+        baseline = loadBaseline(options.baseline);
+        if (baseline.empty()) {
+            std::cerr << "bench: no baseline in " << options.baseline << ", nothing to compare with\n";
+        }
+    }
+
+    std::printf("%s%s\n", COLUMNS, baseline.empty() ? "" : "\tbaseline_ms\tchange_pct");
+    std::vector<std::string> regressions;
+    for (const std::string& family : options.families) {
+        for (size_t vertices = 1000; vertices <= options.maxVertices; vertices *= 10) {
+            if (edgeCount(family, vertices) > options.maxEdges) {
+                std::cerr << "bench: skipping " << family << " " << vertices << " (" << edgeCount(family, vertices) << " edges)\n";
+                continue;
+            }
+            std::cerr << "bench: " << family << " " << vertices << "\n";
+            Job job{&options, family, vertices};
+            for (const std::string& row : runIsolated(job)) {
+                std::vector<std::string> fields = split(row);
+                auto base = fields.size() >= 7 ? baseline.find(caseKey(fields)) : baseline.end();
+                if (base == baseline.end() || base->second <= 0) {
+                    std::printf("%s%s\n", row.c_str(), baseline.empty() ? "" : "\t\t");
+                    continue;
+                }
+                double change = (std::strtod(fields[6].c_str(), nullptr) / base->second - 1) * 100;
+                std::printf("%s\t%.6f\t%+.1f\n", row.c_str(), base->second, change);
+                if (change > options.threshold && base->second >= NOISE_FLOOR_MS) {
+                    char line[256];
+                    std::snprintf(line, sizeof line, "%s %s %s %s: %+.1f%%", fields[0].c_str(), fields[1].c_str(),
+                                  fields[2].c_str(), fields[3].c_str(), change);
+                    regressions.push_back(line);
+                }
+            }
+            std::fflush(stdout);
+        }
+    }
+    if (!baseline.empty()) {
+        std::cerr << "bench: " << regressions.size() << " cases more than " << options.threshold << "% slower than the baseline\n";
+        for (const std::string& regression : regressions) {
+            std::cerr << "  " << regression << "\n";
+        }
+    }
+    return regressions.empty() ? 0 : 2;
+}
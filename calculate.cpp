@@ -1,75 +1,71 @@
 #include "calculate.hpp"
+#include "ReplyWriter.hpp"
+#include "Trace.hpp"
 using namespace std;
 
-#include <unistd.h>  // For socket communication
 #include <string>
 #include <limits>
 
-// 1. Calculate the total weight of the MST and send it to the client through the socket
-void calculateTotalWeight(const Tree& tree, int clientSocket) {
+// 1. Calculate the total weight of the MST for the client
+string calculateTotalWeight(const Tree& tree) {
+    TRACE_SPAN("metrics.total_weight");
     double totalWeight = 0.0;
 
-    for (const auto& neighbors : tree.treeAdjList) {
-        for (const auto& neighbor : neighbors) {
-            totalWeight += neighbor.second;  // Add the weight of each edge
-        }
+    for (double weight : tree.edgeWeights()) {
+        totalWeight += weight;  // Add the weight of each edge (stored once per edge)
     }
-    totalWeight /= 2.0;  // Each edge is counted twice (u->v and v->u)
-
-    string msg = "The Total weight of the MST is: " + to_string(totalWeight) + "\n";
-    write(clientSocket, msg.c_str(), msg.size());
 
+    string msg;
+    ReplyWriter(msg) << "The Total weight of the MST is: " << ReplyWriter::fixed(totalWeight) << '\n';
+    return msg;
 }
 
-// 2. Calculate the longest distance between two vertices and send it to the client through the socket
-void calculateLongestDistance(const Tree& tree, int clientSocket) {
+// 2. Calculate the longest distance between two vertices for the client
+string calculateLongestDistance(const Tree& tree) {
+    TRACE_SPAN("metrics.longest_distance");
     double maxDistance = 0.0;
 
-    for (const auto& neighbors : tree.treeAdjList) {
-        for (const auto& neighbor : neighbors) {
-            if (neighbor.second > maxDistance) {
-                maxDistance = neighbor.second;  // Track the maximum edge weight
-            }
+    for (double weight : tree.edgeWeights()) {
+        if (weight > maxDistance) {
+            maxDistance = weight;  // Track the maximum edge weight
         }
     }
-    string msg = "Longest distance between two vertices is: " + to_string(maxDistance) + "\n";
-    write(clientSocket, msg.c_str(), msg.size());
-
+    string msg;
+    ReplyWriter(msg) << "Longest distance between two vertices is: " << ReplyWriter::fixed(maxDistance) << '\n';
+    return msg;
 }
 
-// 3. Calculate the average distance between any two vertices and send it to the client through the socket
-void calculateAverageDistance(const Tree& tree, int clientSocket) {
+// 3. Calculate the average distance between any two vertices for the client
+string calculateAverageDistance(const Tree& tree) {
+    TRACE_SPAN("metrics.average_distance");
     double totalDistance = 0.0;
     int pairCount = 0;
 
-    // Loop through the adjacency list to accumulate distances
-    for (size_t i = 0; i < tree.treeAdjList.size(); ++i) {
-        for (const auto& neighbor : tree.treeAdjList[i]) {
-            if (i < neighbor.first) {  // Ensure that each edge is only counted once
-                totalDistance += neighbor.second;
-                pairCount++;
-            }
-        }
+    // Loop through the edge weights to accumulate distances (each edge appears once)
+    for (double weight : tree.edgeWeights()) {
+        totalDistance += weight;
+        pairCount++;
     }
 
     // Calculate the average distance
     double average = pairCount > 0 ? totalDistance / pairCount : 0.0;
-    string msg = "The average distance between vertecies in the graph is: " + to_string(average) + "\n";
-    write(clientSocket, msg.c_str(), msg.size());
+    string msg;
+    ReplyWriter(msg) << "The average distance between vertecies in the graph is: " << ReplyWriter::fixed(average) << '\n';
+    return msg;
 }
 
-void calculateShortestDistance(const Tree& tree, int clientSocket) {
+string calculateShortestDistance(const Tree& tree) {
+    TRACE_SPAN("metrics.shortest_distance");
     // Initialize minDistance to the largest possible value
     double minDistance = std::numeric_limits<double>::max();
 
-    for (const auto& neighbors : tree.treeAdjList) {
-        for (const auto& neighbor : neighbors) {
-            if (neighbor.second < minDistance && neighbor.second > 0) {  
-                // Track the minimum edge weight
-                minDistance = neighbor.second;
-            }
+    for (double weight : tree.edgeWeights()) {
+        if (weight < minDistance && weight > 0) {
+            // Track the minimum edge weight
+            minDistance = weight;
         }
     }
-     string msg = "Shortest distance between two vertices is: " + to_string(minDistance) + "\n";
-    write(clientSocket, msg.c_str(), msg.size());
+    string msg;
+    ReplyWriter(msg) << "Shortest distance between two vertices is: " << ReplyWriter::fixed(minDistance) << '\n';
+    return msg;
 }
@@ -1,16 +1,19 @@
 #pragma once
 #include "MSTFactory.hpp"
+#include <string>
+
+// Each function formats one metrics line of the serverPipe reply
 
 // Total weight of the MST
-void calculateTotalWeight(const Tree& tree, int clientSocket);
+std::string calculateTotalWeight(const Tree& tree);
 
 // Longest distance between two vertices
-void calculateLongestDistance(const Tree& tree, int clientSocket);
+std::string calculateLongestDistance(const Tree& tree);
 
 // Average distance between and two edges n the graph.
 //  ○ assume distance (x,x)=0 for any X
 //  ○ We are interested in avg of all distances Xi,Xj where i=1..n j≥i.
-void calculateAverageDistance(const Tree& tree, int clientSocket);
+std::string calculateAverageDistance(const Tree& tree);
 
 // Shortest distance between two vertices Xi,Xj where i≠j and edge belongs to MST
-void calculateShortestDistance(const Tree& tree, int clientSocket);
\ No newline at end of file
+std::string calculateShortestDistance(const Tree& tree);
\ No newline at end of file
@@ -0,0 +1,579 @@
+/* Load generator for server and serverPipe.
+Opens many connections, each with a private graph of its own, and replays a weighted mix of
+text commands on them from a few threads (one epoll loop per thread):
+    build               new_graph and add_edge lines recreating the connection's graph, and
+                        an MST Kruskal so that calculate_mst_data has an MST to work on
+    MST                 MST with one of the chosen algorithms (each is reported separately)
+    calculate_mst_data  metrics of the connection's last MST (server only: serverPipe sends
+                        them with every MST reply and does not know the command)
+    print_graph         the whole adjacency list
+Every request is followed by a ping; its "pong" marks where the replies end, since text
+replies have no framing of their own. A connection has one request outstanding at a time.
+
+Closed loop (default): each connection sends its next request as soon as the reply to the
+previous one is in, so the load adapts to the server and throughput is the result.
+Open loop (-r): requests are due at a fixed total rate, spread evenly over the connections.
+A request due while its connection still waits for a reply is sent as soon as it is free,
+and its latency counts from when it was due, not from when it went out: a stalled server
+delays every request scheduled behind the stall, and leaving that time out (coordinated
+omission) would hide the stall from the percentiles. latency_seconds is that corrected
+latency; service_seconds is the time from sending to the reply, what a closed loop sees.
+
+Requests that were due during the warm-up (-w) are not recorded. A request still waiting for
+its reply when the run ends is counted as unanswered, and its latency is recorded as the time
+from when it was due to the end: at least that long, and leaving it out would again hide a stall. The report is the throughput
+and the Stats histograms: count, mean, p50, p90, p99, p99.9 and max per command.
+*/
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <thread>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "MSTFactory.hpp"
+#include "CommandTable.hpp"
+#include "Stats.hpp"
+#include "ReplyWriter.hpp"
+
+namespace {
+
+const char PING[] = "ping\n";
+const char PONG[] = "pong\n";
+const size_t PONG_SIZE = sizeof PONG - 1;
+const size_t READ_CHUNK = 16384;
+const int MAX_EVENTS = 64;
+const uint64_t IDLE_WAIT_NS = 100000000;  // Closed loop: how often a thread looks at the clock
+// Replies that mean the command failed
+const char* const ERROR_PREFIXES[] = {"Unknown", "Invalid", "Error", "No graph", "MST not computed", "Server busy"};
+
+struct Options {
+    std::string host = "127.0.0.1";
+    std::string port = "9034";
+    size_t connections = 16;
+    size_t threads = 4;
+    double seconds = 10;
+    double warmup = 1;
+    double rate = 0;           // Requests per second over all connections; 0 = closed loop
+    std::string mix = "MST=60,calculate_mst_data=20,print_graph=10,build=10";
+    std::string algorithms = "Kruskal,Prim,Boruvka,Tarjan,Integer";
+    int vertices = 100;
+    size_t edges = 400;
+};
+
+// One kind of request and where its results go
+struct Kind {
+    std::string label;
+    std::string text;          // Empty for build: every connection has its own graph
+    double weight;
+    Stats::Id latency;
+    Stats::Id service;
+    Stats::Id requests;
+    Stats::Id errors;
+};
+
+struct Connection {
+    int fd = -1;
+    std::mt19937_64 random;
+    std::string build;         // Recreates this connection's graph and its MST
+    std::string in;
+    std::string out;
+    size_t written = 0;
+    bool busy = false;
+    bool writing = false;      // Waiting for EPOLLOUT
+    bool lost = false;
+    size_t kind = 0;
+    uint64_t due = 0;          // When the outstanding request was due
+    uint64_t sent = 0;
+    uint64_t next = 0;         // Open loop: when the next request is due
+};
+
+// What a thread saw while measuring
+struct Tally {
+    uint64_t completed = 0;
+    uint64_t errors = 0;
+    uint64_t lost = 0;         // Connections the server closed
+    uint64_t behind = 0;       // Open loop: requests due but not sent when the run ended
+    uint64_t unanswered = 0;   // Requests sent but without their reply when the run ended
+};
+
+struct Run {
+    const Options* options;
+    std::vector<Kind>* kinds;
+    std::vector<double> cumulative;  // Of the kinds' weights, for picking one
+    uint64_t warmupEnd;
+    uint64_t end;
+    uint64_t interval;               // Open loop: between two requests of a connection, in ns
+};
+
+std::vector<std::string> splitList(const std::string& list) {
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t comma = std::min(list.find(',', start), list.size());
+        if (comma > start) {
+            items.push_back(list.substr(start, comma - start));
+        }
+        start = comma + 1;
+    }
+    return items;
+}
+
+// The kinds named in the mix, MST split evenly over the algorithms; false if either is malformed
+bool parseMix(const Options& options, std::vector<Kind>& kinds) {
+    std::vector<MSTFactory::Algorithm> algorithms;
+    for (const std::string& name : splitList(options.algorithms)) {
+        MSTFactory::Algorithm algorithm;
+        if (!MSTFactory::fromName(name, algorithm)) {
+            std::cerr << "loadgen: unknown algorithm " << name << "\n";
+            return false;
+        }
+        algorithms.push_back(algorithm);
+    }
+    for (const std::string& entry : splitList(options.mix)) {
+        size_t equals = entry.find('=');
+        std::string command = entry.substr(0, equals);
+        double weight = 1;
+        if (equals != std::string::npos && !CommandArgs::parse(std::string_view(entry).substr(equals + 1), weight)) {
+            weight = 0;
+        }
+        if (!(weight > 0) || !std::isfinite(weight)) {
+            std::cerr << "loadgen: bad weight in " << entry << "\n";
+            return false;
+        }
+        if (command == "MST") {
+            for (MSTFactory::Algorithm algorithm : algorithms) {
+                std::string label = std::string("MST ") + MSTFactory::name(algorithm);
+                kinds.push_back(Kind{label, label + "\n", weight / (double)algorithms.size()});
+            }
+        } else if (command == "calculate_mst_data" || command == "print_graph") {
+            kinds.push_back(Kind{command, command + "\n", weight});
+        } else if (command == "build") {
+            kinds.push_back(Kind{command, "", weight});
+        } else {
+            std::cerr << "loadgen: unknown command " << command << " in the mix\n";
+            return false;
+        }
+    }
+    if (kinds.empty() || (algorithms.empty() && options.mix.find("MST") != std::string::npos)) {
+        std::cerr << "loadgen: nothing to send\n";
+        return false;
+    }
+    for (Kind& kind : kinds) {
+        std::string labels = "command=\"" + kind.label + "\"";
+        kind.latency = Stats::histogram("latency_seconds", labels);
+        kind.service = Stats::histogram("service_seconds", labels);
+        kind.requests = Stats::counter("requests", labels);
+        kind.errors = Stats::counter("errors", labels);
+    }
+    return true;
+}
+
+// A connected graph: a random spanning tree, then random extra edges; integer weights so
+// the Integer algorithm accepts it
+std::string buildCommands(std::mt19937_64& random, int vertices, size_t edges) {
+    std::string text;
+    ReplyWriter writer(text);
+    writer << "new_graph " << vertices << "\n";
+    std::uniform_int_distribution<int> weight(1, 100), any(0, vertices - 1);
+    for (int v = 1; v < vertices; ++v) {
+        writer << "add_edge " << std::uniform_int_distribution<int>(0, v - 1)(random) << ' ' << v << ' ' << weight(random) << "\n";
+    }
+    for (size_t added = (size_t)std::max(vertices - 1, 0); added < edges && vertices > 1;) {
+        int u = any(random), v = any(random);
+        if (u != v) {
+            writer << "add_edge " << u << ' ' << v << ' ' << weight(random) << "\n";
+            ++added;
+        }
+    }
+    return text;
+}
+
+// The reply ends with the pong of the ping sent after the request
+bool replyComplete(const std::string& in) {
+    return in.size() >= PONG_SIZE && in.compare(in.size() - PONG_SIZE, PONG_SIZE, PONG) == 0 &&
+           (in.size() == PONG_SIZE || in[in.size() - PONG_SIZE - 1] == '\n');
+}
+
+bool replyFailed(const std::string& in) {
+    for (size_t line = 0; line < in.size(); line = in.find('\n', line) + 1) {
+        for (const char* prefix : ERROR_PREFIXES) {
+            if (in.compare(line, std::strlen(prefix), prefix) == 0) {
+                return true;
+            }
+        }
+        if (in.find('\n', line) == std::string::npos) {
+            break;
+        }
+    }
+    return false;
+}
+
+int connectTo(const Options& options) {
+    struct addrinfo hints, *servinfo;
+    std::memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int rv = getaddrinfo(options.host.c_str(), options.port.c_str(), &hints, &servinfo);
+    if (rv != 0) {
+        std::cerr << "loadgen: " << options.host << ": " << gai_strerror(rv) << "\n";
+        return -1;
+    }
+    int fd = -1;
+    for (struct addrinfo* p = servinfo; p != nullptr && fd == -1; p = p->ai_next) {
+        fd = socket(p->ai_family, p->ai_socktype | SOCK_CLOEXEC, p->ai_protocol);
+        if (fd != -1 && connect(fd, p->ai_addr, p->ai_addrlen) == -1) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(servinfo);
+    if (fd != -1) {
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+    }
+    return fd;
+}
+
+// Blocking: sends text and waits for its pong; false if the server closed or refused
+bool exchange(int fd, const std::string& text, std::string& reply) {
+    for (size_t done = 0; done < text.size();) {
+        ssize_t sent = send(fd, text.data() + done, text.size() - done, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        done += (size_t)sent;
+    }
+    reply.clear();
+    char buffer[READ_CHUNK];
+    while (!replyComplete(reply)) {
+        ssize_t received = recv(fd, buffer, sizeof buffer, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        reply.append(buffer, (size_t)received);
+    }
+    return true;
+}
+
+void watch(int epollFd, Connection& conn, int op) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN | (conn.writing ? EPOLLOUT : 0);
+    ev.data.ptr = &conn;
+    epoll_ctl(epollFd, op, conn.fd, &ev);
+}
+
+void drop(int epollFd, Connection& conn, Tally& tally) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, conn.fd, nullptr);
+    conn.lost = true;
+    ++tally.lost;
+}
+
+// Writes what the socket takes of the request; the rest waits for EPOLLOUT
+void flush(int epollFd, Connection& conn, Tally& tally) {
+    while (conn.written < conn.out.size()) {
+        ssize_t sent = send(conn.fd, conn.out.data() + conn.written, conn.out.size() - conn.written, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (sent <= 0) {
+            drop(epollFd, conn, tally);
+            return;
+        }
+        conn.written += (size_t)sent;
+    }
+    bool writing = conn.written < conn.out.size();
+    if (writing != conn.writing) {
+        conn.writing = writing;
+        watch(epollFd, conn, EPOLL_CTL_MOD);
+    }
+}
+
+void start(const Run& run, int epollFd, Connection& conn, uint64_t due, Tally& tally) {
+    double pick = std::uniform_real_distribution<double>(0, run.cumulative.back())(conn.random);
+    conn.kind = (size_t)(std::upper_bound(run.cumulative.begin(), run.cumulative.end(), pick) - run.cumulative.begin());
+    conn.kind = std::min(conn.kind, run.cumulative.size() - 1);
+    const Kind& kind = (*run.kinds)[conn.kind];
+    conn.out = kind.text.empty() ? conn.build : kind.text;
+    conn.out += PING;
+    conn.written = 0;
+    conn.in.clear();
+    conn.busy = true;
+    conn.due = due;
+    conn.sent = Stats::now();
+    flush(epollFd, conn, tally);
+}
+
+// Reads what arrived; returns true once the whole reply is in
+bool receive(int epollFd, Connection& conn, Tally& tally) {
+    char buffer[READ_CHUNK];
+    while (true) {
+        ssize_t received = recv(conn.fd, buffer, sizeof buffer, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return replyComplete(conn.in);
+        }
+        if (received <= 0) {
+            drop(epollFd, conn, tally);
+            return false;
+        }
+        conn.in.append(buffer, (size_t)received);
+    }
+}
+
+void finish(const Run& run, Connection& conn, uint64_t now, Tally& tally) {
+    if (now > run.end) {
+        return;  // Still in flight at the end, as far as the run is concerned
+    }
+    conn.busy = false;
+    if (conn.due < run.warmupEnd) {
+        return;
+    }
+    const Kind& kind = (*run.kinds)[conn.kind];
+    Stats::record(kind.latency, now - conn.due);
+    Stats::record(kind.service, now - conn.sent);
+    Stats::add(kind.requests);
+    ++tally.completed;
+    if (replyFailed(conn.in)) {
+        Stats::add(kind.errors);
+        ++tally.errors;
+    }
+}
+
+// One thread's event loop over its share of the connections
+void drive(const Run& run, std::vector<Connection*> connections, Tally& tally) {
+    bool open = run.interval > 0;
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    for (Connection* conn : connections) {
+        watch(epollFd, *conn, EPOLL_CTL_ADD);
+    }
+    struct epoll_event events[MAX_EVENTS];
+    while (true) {
+        uint64_t now = Stats::now();
+        if (now >= run.end) {
+            break;
+        }
+        uint64_t wake = std::min(run.end, now + IDLE_WAIT_NS);
+        for (Connection* conn : connections) {
+            if (conn->lost || conn->busy) {
+                continue;
+            }
+            if (!open) {
+                start(run, epollFd, *conn, now, tally);
+            } else if (conn->next <= now) {
+                start(run, epollFd, *conn, conn->next, tally);
+                conn->next += run.interval;
+            } else {
+                wake = std::min(wake, conn->next);
+            }
+        }
+        uint64_t wait = wake > now ? wake - now : 0;
+        struct timespec timeout = {(time_t)(wait / 1000000000), (long)(wait % 1000000000)};
+        int ready = epoll_pwait2(epollFd, events, MAX_EVENTS, &timeout, nullptr);
+        for (int i = 0; i < ready; ++i) {
+            Connection& conn = *static_cast<Connection*>(events[i].data.ptr);
+            if (conn.lost) {
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                flush(epollFd, conn, tally);
+            }
+            if (!conn.lost && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && receive(epollFd, conn, tally)) {
+                finish(run, conn, Stats::now(), tally);
+            }
+        }
+    }
+    for (Connection* conn : connections) {
+        if (conn->lost) {
+            continue;
+        }
+        if (conn->busy && conn->due >= run.warmupEnd) {
+            Stats::record((*run.kinds)[conn->kind].latency, run.end - conn->due);
+            ++tally.unanswered;
+        }
+        if (open && conn->next < run.end) {
+            tally.behind += (run.end - conn->next) / run.interval + 1;
+        }
+    }
+    close(epollFd);
+}
+
+void usage(const char* program) {
+    std::cerr << "Usage: " << program << " [-h host] [-p port] [-c connections] [-t threads] [-d seconds] [-w seconds]\n"
+              << "       [-r rate] [-x mix] [-a algorithms] [-v vertices] [-e edges]\n"
+              << "  -h, -p  server address (default: 127.0.0.1 9034)\n"
+              << "  -c  connections (default: 16), -t  threads driving them (default: 4)\n"
+              << "  -d  seconds measured (default: 10), after -w seconds of warm-up (default: 1)\n"
+              << "  -r  open loop: requests per second over all connections (default: 0, closed loop)\n"
+              << "  -x  command mix as command=weight,... out of build, MST, calculate_mst_data, print_graph\n"
+              << "      (default: MST=60,calculate_mst_data=20,print_graph=10,build=10)\n"
+              << "  -a  algorithms the MST requests cycle through (default: Kruskal,Prim,Boruvka,Tarjan,Integer)\n"
+              << "  -v, -e  size of each connection's graph (default: 100 vertices, 400 edges)\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    unsigned long count = 0;
+    double number = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "h:p:c:t:d:w:r:x:a:v:e:")) != -1) {
+        // The numeric options must be numbers and nothing else
+        if ((std::strchr("ctve", opt) != nullptr && !CommandArgs::parse(optarg, count)) ||
+            (std::strchr("dwr", opt) != nullptr && (!CommandArgs::parse(optarg, number) || !std::isfinite(number)))) {
+            usage(argv[0]);
+            return 1;
+        }
+        switch (opt) {
+            case 'h':
+                options.host = optarg;
+                break;
+            case 'p':
+                options.port = optarg;
+                break;
+            case 'c':
+                options.connections = std::max(1ul, count);
+                break;
+            case 't':
+                options.threads = std::max(1ul, count);
+                break;
+            case 'd':
+                options.seconds = number;
+                break;
+            case 'w':
+                options.warmup = std::max(0.0, number);
+                break;
+            case 'r':
+                options.rate = std::max(0.0, number);
+                break;
+            case 'x':
+                options.mix = optarg;
+                break;
+            case 'a':
+                options.algorithms = optarg;
+                break;
+            case 'v':
+                if (count > (unsigned long)std::numeric_limits<int>::max()) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                options.vertices = std::max(1, (int)count);
+                break;
+            case 'e':
+                options.edges = count;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    std::vector<Kind> kinds;
+    if (options.seconds <= 0 || !parseMix(options, kinds)) {
+        usage(argv[0]);
+        return 1;
+    }
+    options.threads = std::min(options.threads, options.connections);
+
+    // Every connection gets its graph and a first MST before the clock starts
+    std::vector<Connection> connections(options.connections);
+    std::string reply;
+    for (size_t i = 0; i < connections.size(); ++i) {
+        Connection& conn = connections[i];
+        conn.random.seed(i + 1);
+        conn.build = buildCommands(conn.random, options.vertices, options.edges) + "MST Kruskal\n";
+        conn.fd = connectTo(options);
+        if (conn.fd == -1 || !exchange(conn.fd, conn.build + PING, reply) || replyFailed(reply)) {
+            std::cerr << "loadgen: connection " << i << " could not be set up" << (reply.empty() ? "" : ": ") << reply
+                      << (conn.fd == -1 ? std::string(": ") + std::strerror(errno) + "\n" : "");
+            return 1;
+        }
+        fcntl(conn.fd, F_SETFL, fcntl(conn.fd, F_GETFL) | O_NONBLOCK);
+    }
+
+    Run run;
+    run.options = &options;
+    run.kinds = &kinds;
+    double total = 0;
+    for (const Kind& kind : kinds) {
+        run.cumulative.push_back(total += kind.weight);
+    }
+    uint64_t begin = Stats::now();
+    run.warmupEnd = begin + (uint64_t)(options.warmup * 1e9);
+    run.end = run.warmupEnd + (uint64_t)(options.seconds * 1e9);
+    run.interval = options.rate > 0 ? std::max<uint64_t>(1, (uint64_t)((double)options.connections / options.rate * 1e9)) : 0;
+    std::mt19937_64 stagger(0);
+    for (Connection& conn : connections) {
+        // Spread the connections' schedules over one interval, so they do not all fire together
+        conn.next = begin + (run.interval > 0 ? stagger() % run.interval : 0);
+    }
+
+    std::vector<Tally> tallies(options.threads);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < options.threads; ++t) {
+        std::vector<Connection*> share;
+        for (size_t i = t; i < connections.size(); i += options.threads) {
+            share.push_back(&connections[i]);
+        }
+        threads.emplace_back(drive, std::cref(run), share, std::ref(tallies[t]));
+    }
+    Tally sum;
+    for (size_t t = 0; t < options.threads; ++t) {
+        threads[t].join();
+        sum.completed += tallies[t].completed;
+        sum.errors += tallies[t].errors;
+        sum.lost += tallies[t].lost;
+        sum.behind += tallies[t].behind;
+        sum.unanswered += tallies[t].unanswered;
+    }
+    for (Connection& conn : connections) {
+        close(conn.fd);
+    }
+
+    std::string report;
+    ReplyWriter writer(report);
+    writer << "loadgen: " << options.host << ':' << options.port << ", " << options.connections << " connections on "
+           << options.threads << " threads, ";
+    if (options.rate > 0) {
+        writer << "open loop at " << options.rate << " requests/s";
+    } else {
+        writer << "closed loop";
+    }
+    writer << ", " << options.seconds << " s measured after " << options.warmup << " s of warm-up\n";
+    writer << "completed " << sum.completed << " requests (" << sum.errors << " failed), "
+           << (double)sum.completed / options.seconds << " requests/s\n";
+    if (sum.lost > 0) {
+        writer << "the server closed " << sum.lost << " connections\n";
+    }
+    if (sum.behind > 0) {
+        writer << sum.behind << " requests were due but not sent by the end: the server did not keep up with the rate\n";
+    }
+    if (sum.unanswered > 0) {
+        writer << sum.unanswered << " requests had no reply by the end (in latency_seconds up to the end)\n";
+    }
+    Stats::writeText(report);
+    std::cout << report;
+    return sum.errors > 0 || sum.lost > 0 ? 2 : 0;
+}
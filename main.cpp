@@ -60,10 +60,11 @@ int main() {
     }
 
     // Calculate additional data
-    double totalWeight = mst.calculateTotalWeight();
-    double longestDistance = mst.calculateLongestDistance();
-    double averageDistance = mst.calculateAverageDistance();
-    double shortestDistance = mst.calculateShortestDistance();
+    TreeMetrics metrics = mst.calculateMetrics();  // One pass computes all four
+    double totalWeight = metrics.totalWeight;
+    double longestDistance = metrics.longestDistance;
+    double averageDistance = metrics.averageDistance;
+    double shortestDistance = metrics.shortestDistance;
 
     cout << "Total Weight: " << totalWeight << endl;
     cout << "Longest Distance: " << longestDistance << endl;
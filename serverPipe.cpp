@@ -1,9 +1,9 @@
 #include <iostream>
-#include <sstream>
 #include <vector>
 #include <unordered_map>
 #include <string>
 #include <cstring>
+#include <cerrno>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -16,18 +16,29 @@
 #include <mutex>
 #include <condition_variable>
 #include <functional>
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include "Graph.hpp"
 #include "Tree.hpp"
 #include "MSTFactory.hpp"
 #include "calculate.hpp"
+#include "GraphCommands.hpp"
+#include "GraphStore.hpp"
+#include "Logger.hpp"
+#include "Stats.hpp"
+#include "AdminServer.hpp"
+#include "BoundedQueue.hpp"
+#include "Reactor.hpp"
+#include "ThreadPool.hpp"
 
 #define PORT "9034"  // Port to listen on
-#define BACKLOG 10   // Number of pending connections queue will hold
-#define BUFFER_SIZE 1024
+#define BACKLOG 128  // Number of pending connections queue will hold
 
 using namespace std;
 
 int sockfd; // Global socket descriptor for cleanup
+GraphStore* store = nullptr;  // Set when named graphs are kept across restarts (-d)
 
 // Function to extract address information from sockaddr structure
 void *get_in_addr(struct sockaddr *sa) {
@@ -37,214 +48,363 @@ void *get_in_addr(struct sockaddr *sa) {
     return &(((struct sockaddr_in6*)sa)->sin6_addr);
 }
 
-// Signal handler to properly close the socket on SIGINT or SIGTERM
-void signalHandler(int signum) {
+// Sends the whole buffer, retrying after partial writes
+bool sendAll(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += sent;
+        length -= (size_t)sent;
+    }
+    return true;
+}
+
+// SIGINT and SIGTERM are blocked in every thread and taken here by sigwait, so closing the
+// socket, committing the journal and flushing the log run in normal context, not in a handler
+void shutdownOnSignal(sigset_t signals) {
+    int signum = 0;
+    if (sigwait(&signals, &signum) != 0) {
+        return;
+    }
     if (sockfd != -1) {
         close(sockfd);
     }
-    std::cout << "\nServer shutting down gracefully...\n";
-    exit(signum);
+    if (store != nullptr) {
+        store->commitNow();  // Edits still buffered by the journal's group commit
+    }
+    LOG(INFO) << "Server shutting down gracefully...";
+    Logger::shared().flush();
+    std::cout.flush();
+    // The I/O and compute threads are still running: exit() would destroy the statics they
+    // use (registry, pools, stats) under them, so leave without running destructors
+    _exit(signum);
 }
 
+struct PipelineJob;
+using JobPtr = std::shared_ptr<PipelineJob>;
+
+// A long-lived thread that runs its task on every message posted to it, in order.
+// Messages travel through a bounded lock-free ring; a full ring blocks the sender.
+// The time each message waits in the ring and the task's run time are recorded under the name.
 class ActiveObject {
 public:
-    using Task = std::function<void(Tree tree, int client_fd)>;
-
-    ActiveObject(Task task) : task_(task), stop_(false) {
+    using Task = std::function<void(const JobPtr& job)>;
+    static const size_t QUEUE_CAPACITY = 1024;
+    static const size_t BATCH_SIZE = 64;
+
+    ActiveObject(const std::string& name, Task task)
+        : task_(task), queue_(QUEUE_CAPACITY),
+          queueWait_(Stats::histogram("queue_wait_seconds", "queue=\"" + name + "\"")),
+          runTime_(Stats::histogram("stage_seconds", "stage=\"" + name + "\"")) {
         thread_ = std::thread(&ActiveObject::run, this);
     }
 
     ~ActiveObject() {
-        {
-            std::unique_lock<std::mutex> lock(mutex_);
-            stop_ = true;
-            cv_.notify_all();
-        }
+        queue_.close();
         thread_.join();
     }
 
-    void send(Tree tree, int client_fd) {
-        std::unique_lock<std::mutex> lock(mutex_);
-        queue_.emplace(tree, client_fd);
-        cv_.notify_one();
+    void send(JobPtr job) {
+        queue_.push(Message{std::move(job), Stats::now()});
     }
 
 private:
+    struct Message {
+        JobPtr job;
+        uint64_t queued = 0;
+    };
+
     void run() {
-        while (true) {
-            std::pair<Tree, int> data;
-            {
-                std::unique_lock<std::mutex> lock(mutex_);
-                cv_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
-                if (stop_ && queue_.empty()) return;
-                data = queue_.front();
-                queue_.pop();
+        std::vector<Message> batch;
+        batch.reserve(BATCH_SIZE);
+        while (queue_.popBatch(batch, BATCH_SIZE) > 0) {
+            for (const Message& message : batch) {
+                uint64_t start = Stats::now();
+                Stats::record(queueWait_, start - message.queued);
+                task_(message.job);
+                Stats::record(runTime_, Stats::now() - start);
             }
-            task_(data.first, data.second);
+            batch.clear();
         }
     }
 
     Task task_;
+    BoundedQueue<Message> queue_;
+    Stats::Id queueWait_;
+    Stats::Id runTime_;
     std::thread thread_;
-    std::queue<std::pair<Tree, int>> queue_;  // The function arguments
-    std::mutex mutex_;
-    std::condition_variable cv_;
-    bool stop_;
 };
 
+// One piece of output for a client: a ready reply, or the metrics of an MST still being computed
+struct PipelineJob {
+    int client_fd;
+    uint64_t client;                       // Connection id; fds are reused, ids are not
+    uint64_t sequence;                     // Position in the client's output
+    std::shared_ptr<const Tree> tree;
+    std::vector<std::string> parts;        // One slot per stage, written in stage order
+    std::atomic<size_t> remaining{0};      // Stages still running
+    bool closeAfter = false;
+};
+
+/* The metrics pipeline, built once at startup.
+Every stage is a long-lived ActiveObject; an MST is posted to all of them at once, so the
+stages run concurrently on the same (immutable) tree. The stage that finishes last hands the
+job to the commit stage, which is the only producer of client output: it buffers jobs that
+arrive early and hands each client's output to the writer strictly in sequence order.
+Plain replies go through the commit stage too, so they cannot overtake the metrics of an
+earlier MST. Jobs of all clients share the same stage threads, tagged with their client.
+*/
 class Pipeline {
 public:
-    void addStage(ActiveObject::Task task) {
-        stages_.emplace_back(std::make_shared<ActiveObject>(task));
+    using Stage = std::function<std::string(const Tree& tree)>;
+    // Delivers a client's output in order; keep=false after the last of it
+    using Writer = std::function<void(int client_fd, std::string text, bool keep)>;
+
+    // Per-connection handle; sequence numbers are assigned by whoever runs the client's commands
+    struct Client {
+        int fd;
+        uint64_t id;
+        uint64_t next = 0;
+    };
+
+    explicit Pipeline(Writer writer)
+        : writer_(std::move(writer)), committer_(std::make_unique<ActiveObject>("commit", [this](const JobPtr& job) { commit(job); })) {}
+
+    ~Pipeline() {
+        stages_.clear();  // Drain the stages before the commit stage goes away
+    }
+
+    void addStage(const std::string& name, Stage stage) {
+        stages_.emplace_back(std::make_unique<ActiveObject>(name, [this, stage, index = stages_.size()](const JobPtr& job) {
+            job->parts[index] = stage(*job->tree);
+            if (job->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                committer_->send(job);
+            }
+        }));
     }
 
-    void execute(Tree tree, int client_fd) {
-        for (size_t i = 0; i < stages_.size(); ++i) {
-            stages_[i]->send(tree, client_fd);
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));   // To ensure they are sent in order
+    void execute(Client& client, std::shared_ptr<const Tree> tree) {
+        JobPtr job = makeJob(client, stages_.size());
+        job->tree = std::move(tree);
+        job->remaining.store(stages_.size(), std::memory_order_relaxed);
+        if (stages_.empty()) {
+            committer_->send(job);
+            return;
+        }
+        for (auto& stage : stages_) {
+            stage->send(job);
         }
     }
 
+    void reply(Client& client, std::string text) {
+        JobPtr job = makeJob(client, 1);
+        job->parts[0] = std::move(text);
+        committer_->send(std::move(job));
+    }
+
+    // Ends the client's output once everything queued for it has been written
+    void finish(Client& client) {
+        JobPtr job = makeJob(client, 0);
+        job->closeAfter = true;
+        committer_->send(std::move(job));
+    }
+
 private:
-    std::vector<std::shared_ptr<ActiveObject>> stages_;
-};
+    struct ClientOutput {
+        uint64_t next = 0;
+        std::unordered_map<uint64_t, JobPtr> early;  // Finished ahead of their turn
+    };
+
+    JobPtr makeJob(Client& client, size_t parts) {
+        JobPtr job = std::make_shared<PipelineJob>();
+        job->client_fd = client.fd;
+        job->client = client.id;
+        job->sequence = client.next++;
+        job->parts.resize(parts);
+        return job;
+    }
 
-// Each client runs this method independantly (threads)
-void handle_client(int client_fd) {
-    std::cout << "Handling request..." << std::endl;
-
-    char buffer[1024];
-    std::string command = "";
-    Graph graph(5); // Default graph with 5 vertices
-    Tree mst;
-    while (true) { 
-        memset(buffer, 0, sizeof(buffer));
-        int bytes_received = recv(client_fd, buffer, sizeof(buffer) - 1, 0);  // Receive command from client
-        if (bytes_received <= 0) {
-            cout << "test" << endl;
-            break;  // Exit loop if the connection is closed or there's an error
+    // Runs on the commit thread only
+    void commit(const JobPtr& job) {
+        ClientOutput& output = outputs_[job->client];
+        output.early.emplace(job->sequence, job);
+        for (auto it = output.early.find(output.next); it != output.early.end(); it = output.early.find(output.next)) {
+            JobPtr ready = std::move(it->second);
+            output.early.erase(it);
+            ++output.next;
+            std::string text;
+            for (std::string& part : ready->parts) {
+                text += part;
+            }
+            if (ready->closeAfter) {
+                writer_(ready->client_fd, std::move(text), false);
+                outputs_.erase(job->client);
+                return;
+            }
+            writer_(ready->client_fd, std::move(text), true);
         }
-        command = std::string(buffer);
-        command = command.substr(0, command.find("\n")); // Remove trailing newline character
-        std::cout << "Received command: " << command << std::endl;
+    }
 
-        if (command == "end") {
-            break;
-        }
-        std::istringstream iss(command);
-        std::string action;
-        iss >> action;
-        // Create a new graph
-        if (action == "new_graph") {
-            int num_vertices;
-            iss >> num_vertices;
-            graph = Graph(num_vertices); // Create a new graph with the specified number of vertices
-            std::string response = "New graph created with " + std::to_string(num_vertices) + " vertices.\n";
-            send(client_fd, response.c_str(), response.length(), 0);
+    Writer writer_;
+    std::unordered_map<uint64_t, ClientOutput> outputs_;
+    std::unique_ptr<ActiveObject> committer_;
+    std::vector<std::unique_ptr<ActiveObject>> stages_;
+};
+
+// A client's state; its commands run one at a time, on whichever worker the reactor picks.
+// The MST is shared read-only with the metrics stages.
+struct Session : GraphSession {
+    Pipeline::Client client;
+    Pipeline *pipeline = nullptr;
+};
+
+// MST replies come out of the pipeline: the optional binary image, then the metrics lines
+void runMst(Session& session, CommandArgs& args, std::string& out) {
+    GraphCommands::MstRequest request;
+    uint64_t start = Stats::now();
+    if (!GraphCommands::parseMst(args, request, out)) {
+        return;
+    }
+    Stats::record(GraphCommands::mstTiming(request.algorithm, GraphCommands::MstPhase::PARSE), Stats::now() - start);
+    GraphCommands::computeMst(session, request.algorithm);
+    // A summary only: whole trees do not fit in a log record
+    LOG(INFO) << "MST computed" << LogField("algorithm", MSTFactory::name(request.algorithm))
+              << LogField("vertices", session.mst->getVertices()) << LogField("edges", session.mst->getEdgesCount());
+    LOG(DEBUG) << "MST weight" << LogField("total", session.mst->calculateTotalWeight());
+    if (request.binary) {
+        {
+            ScopedTimer format(GraphCommands::mstTiming(request.algorithm, GraphCommands::MstPhase::FORMAT));
+            GraphCommands::writeBinaryMst(*session.mst, request, out);
         }
-        // Add edge: format "add_edge vertex1 vertex2 weight"
-        else if (action == "add_edge") {
-            size_t v1, v2;
-            double weight;
-            iss >> v1 >> v2 >> weight;
-            graph.addEdge(v1, v2, weight);
-            std::string response = "Edge added between " + to_string(v1) + " and " + to_string(v2) + " with weight " + std::to_string(weight) + ".\n";
-            send(client_fd, response.c_str(), response.length(), 0);
+        session.pipeline->reply(session.client, std::move(out));
+        out.clear();
+    }
+
+    // The metrics are computed by the long-lived stages and written after the replies above
+    session.pipeline->execute(session.client, session.mst);
+}
+
+// Every text command this server understands
+const CommandTable<Session>& commands() {
+    static const CommandTable<Session> table = [] {
+        CommandTable<Session> table;
+        GraphCommands::addTo(table);
+        table.add("MST", runMst);
+        return table;
+    }();
+    return table;
+}
+
+// Runs one command; every reply goes through the pipeline so it stays in order with the metrics
+void handleCommand(Session& session, const std::string& command) {
+    std::string out;
+    if (!commands().dispatch(session, command, out)) {
+        out = "Unknown command\n";
+    }
+    if (!out.empty()) {
+        session.pipeline->reply(session.client, std::move(out));
+    }
+}
+
+// Prints the command line options
+void usage(const char *program) {
+    std::cerr << "Usage: " << program << " [-n max_connections] [-q queued_per_client] [-f max_in_flight] [-d data_dir] [-s seconds]\n"
+              << "       [-l level[:N]] [-a admin_port]\n"
+              << "  -n  connections beyond this are told to retry later (default: 4096)\n"
+              << "  -q  commands queued per client before its socket is no longer read (default: 64)\n"
+              << "  -f  commands running or queued in the compute pool (default: 4 per compute thread)\n"
+              << "  -d  keep named graphs in this directory (snapshots and journal) and reload them on start\n"
+              << "  -s  seconds between snapshots of the graphs that changed (default: 300)\n"
+              << "  -l  log level: debug (every command), info (default), warn, error or off;\n"
+              << "      level:N keeps 1 in N debug and info records\n"
+              << "  -a  serve Prometheus metrics at http://127.0.0.1:admin_port/metrics (default: off;\n"
+              << "      the stats command shows the same counters and latencies to clients)\n";
+}
+
+int main(int argc, char *argv[]) {
+    // Block the shutdown signals before any thread starts, so every thread inherits the mask
+    sigset_t shutdownSignals;
+    sigemptyset(&shutdownSignals);
+    sigaddset(&shutdownSignals, SIGINT);
+    sigaddset(&shutdownSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &shutdownSignals, nullptr);
+    AdmissionLimits limits;
+    GraphStore::Options storeOptions;
+    unsigned long adminPort = 0;
+    unsigned long value = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:q:f:d:s:l:a:")) != -1) {
+        // The numeric options must be whole numbers
+        if (std::strchr("nqfsa", opt) != nullptr && !CommandArgs::parse(optarg, value)) {
+            usage(argv[0]);
+            return 1;
         }
-        // Remove edge: format "remove_edge vertex1 vertex2"
-        else if (action == "remove_edge") {
-            size_t v1, v2;
-            iss >> v1 >> v2;
-            graph.removeEdge(v1, v2);
-            std::string response = "Edge removed between " + std::to_string(v1) + " and " + std::to_string(v2) + ".\n";
-            send(client_fd, response.c_str(), response.length(), 0);
+        switch (opt) {
+            case 'n':
+                limits.maxConnections = std::max(1ul, value);
+                break;
+            case 'q':
+                limits.maxQueuedCommands = std::max(1ul, value);
+                break;
+            case 'f':
+                limits.maxInFlight = std::max(1ul, value);
+                break;
+            case 'd':
+                storeOptions.directory = optarg;
+                break;
+            case 's':
+                storeOptions.snapshotSeconds = (unsigned)std::max(1ul, value);
+                break;
+            case 'l':
+                if (!Logger::shared().configure(optarg)) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'a':
+                adminPort = value;
+                if (adminPort == 0 || adminPort > 65535) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
         }
-        // Print the current graph
-        else if (action == "print_graph") {
-            std::ostringstream oss;
-            graph.printGraph(oss);  // Assuming printGraph can accept an ostream
-            std::string result = oss.str();
-            send(client_fd, result.c_str(), result.length(), 0);
+    }
+    std::unique_ptr<GraphStore> graphStore;
+    if (!storeOptions.directory.empty()) {
+        try {
+            graphStore = std::make_unique<GraphStore>(storeOptions);
+            graphStore->open();
+        } catch (const std::exception& e) {
+            std::cerr << "serverPipe: cannot open data directory " << storeOptions.directory << ": " << e.what() << std::endl;
+            return 1;
         }
-        // Build MST using specified algorithm and return tree
-        else if (action == "MST") {
-            std::string algorithm;
-            iss >> algorithm;
-            
-            if (algorithm == "Kruskal") {
-                auto mstStrategy = MSTFactory::createMSTStrategy(MSTFactory::Algorithm::KRUSKAL);
-                mst = mstStrategy->computeMST(graph);
-            } 
-            else if (algorithm == "Prim") {
-                auto mstStrategy = MSTFactory::createMSTStrategy(MSTFactory::Algorithm::PRIM);
-                mst = mstStrategy->computeMST(graph);
-            } 
-            else if (algorithm == "Boruvka") {
-                auto mstStrategy = MSTFactory::createMSTStrategy(MSTFactory::Algorithm::Boruvka);
-                mst = mstStrategy->computeMST(graph);
-            } 
-            else if (algorithm == "Tarjan") {
-                auto mstStrategy = MSTFactory::createMSTStrategy(MSTFactory::Algorithm::Tarjan);
-                mst = mstStrategy->computeMST(graph);
-            }
-            else if (algorithm == "Integer") {
-                auto mstStrategy = MSTFactory::createMSTStrategy(MSTFactory::Algorithm::Integer);
-                mst = mstStrategy->computeMST(graph);
-            }
-            else {
-                const char *error_msg = "Unknown MST algorithm\n";
-                send(client_fd, error_msg, strlen(error_msg), 0);
-                continue;
-            }
-        
-            cout << "The MST : \n";
-            mst.printTree();  
-            
-            Pipeline pipeline;
-            // Add stages
-            pipeline.addStage(calculateTotalWeight);
-            pipeline.addStage(calculateLongestDistance);
-            pipeline.addStage(calculateAverageDistance);
-            pipeline.addStage(calculateShortestDistance);
-            // Execute command
-            pipeline.execute(mst, client_fd);
-                
-            //delete mst_algo;
-
+        store = graphStore.get();
+    }
+    std::unique_ptr<AdminServer> admin;
+    if (adminPort != 0) {
+        try {
+            admin = std::make_unique<AdminServer>((uint16_t)adminPort);
+        } catch (const std::system_error& e) {
+            cerr << "server: admin port " << adminPort << ": " << e.what() << endl;
+            return 1;
         }
     }
-}
-
-// Stage 1: Receive Request
-/* accepts incoming client connections and pushes the client file descriptors into the requestQueue.
- This stage is responsible for receiving requests from clients.
-*/
-/*accepts new client connections and pushes the client file descriptor (new_fd) into the 
-    requestQueue. This represents a new connection from a client, and this descriptor is 
-    what will be processed later.
-    */
-
-// Stage 2: Process Commands
-/* waits for requests to be available in requestQueue, pops a request, and processes it. 
-It reads commands from the client, performs various actions (MST computation), and sends the response back to the client.
-*/
-/*When a client file descriptor is available, it pops the client_fd from 
-    the queue and uses it to communicate with the client 
-    */
-// Active Object for processing commands
 
-// Main function
-int main() {
     struct addrinfo hints, *servinfo, *p;
-    struct sockaddr_storage their_addr;
-    socklen_t sin_size;
     int yes = 1;
-    char s[INET6_ADDRSTRLEN];
     int rv;
 
-    // Register signal handlers to clean up on SIGINT and SIGTERM
-    signal(SIGINT, signalHandler);
-    signal(SIGTERM, signalHandler);
+    // Clean up on SIGINT and SIGTERM (blocked since the start of main)
+    std::thread(shutdownOnSignal, shutdownSignals).detach();
 
     memset(&hints, 0, sizeof hints);
     hints.ai_family = AF_INET;  // Use AF_INET for IPv4
@@ -291,22 +451,68 @@ int main() {
         return 1;
     }
 
-    cout << "server: waiting for connections..." << endl;
-
-    while (true) {
-        sin_size = sizeof their_addr;
-        int new_fd = accept(sockfd, (struct sockaddr *)&their_addr, &sin_size);
-        if (new_fd == -1) {
-            perror("accept");
-            continue;
+    // One reactor thread owns every socket, so any number of clients are served at once;
+    // their commands run on the compute pool and all their output comes out of the pipeline
+    std::unordered_map<int, std::unique_ptr<Session>> sessions;
+    std::mutex sessionsMutex;
+    uint64_t nextClient = 0;
+    std::unique_ptr<Reactor> reactor;
+
+    // Stage threads live for the whole run; the MST requests of every client are fanned out to them
+    Pipeline pipeline([&reactor](int fd, std::string text, bool keep) {
+        reactor->post(fd, std::move(text), keep);
+    });
+    pipeline.addStage("total_weight", calculateTotalWeight);
+    pipeline.addStage("longest_distance", calculateLongestDistance);
+    pipeline.addStage("average_distance", calculateAverageDistance);
+    pipeline.addStage("shortest_distance", calculateShortestDistance);
+
+    auto sessionOf = [&](int fd) {
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        return sessions.at(fd).get();
+    };
+    auto onOpen = [&](int fd) {
+        struct sockaddr_storage peer;
+        socklen_t peerSize = sizeof peer;
+        char address[INET6_ADDRSTRLEN] = "?";
+        if (getpeername(fd, (struct sockaddr *)&peer, &peerSize) == 0) {
+            inet_ntop(peer.ss_family, get_in_addr((struct sockaddr *)&peer), address, sizeof address);
         }
+        LOG(INFO) << "server: got connection from " << address;
+        auto session = std::make_unique<Session>();
+        session->client = Pipeline::Client{fd, nextClient++};
+        session->pipeline = &pipeline;
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        sessions[fd] = std::move(session);
+    };
+    auto onCommand = [&](int fd, const std::string& command, std::string&) -> bool {
+        LOG(DEBUG) << "Received command: " << command;
+        if (command == "end") {
+            return false;
+        }
+        Session *session = sessionOf(fd);
+        try {
+            handleCommand(*session, command);
+        } catch (const std::exception& e) {
+            pipeline.reply(session->client, std::string("Error: ") + e.what() + "\n");
+        }
+        return true;
+    };
+    // The connection stays open until the pipeline has written everything queued for it
+    auto onDrain = [&](int fd) {
+        pipeline.finish(sessionOf(fd)->client);
+    };
+    auto onClose = [&](int fd) {
+        {
+            std::lock_guard<std::mutex> lock(sessionsMutex);
+            sessions.erase(fd);
+        }
+        LOG(INFO) << "Request handled.";
+    };
 
-        inet_ntop(their_addr.ss_family, get_in_addr((struct sockaddr *)&their_addr), s, sizeof s);
-        cout << "server: got connection from " << s << endl;
-
-        handle_client(new_fd);
-        close(new_fd);
-    }
+    LOG(INFO) << "server: waiting for connections...";
+    reactor = std::make_unique<Reactor>(sockfd, WorkStealingPool::compute(), onOpen, onCommand, onClose, onDrain, limits);
+    reactor->run();
 
     close(sockfd);  // Ensure socket is closed before exit
     return 0;